@@ -7,33 +7,130 @@
 #include <GLES2/gl2.h>
 #endif
 #include <GLFW/glfw3.h>
+#include <cmath>
 
 #include <common/machine.hpp>
 #include <common/registers.hpp>
+#include <common/runner.hpp>
+#include <cpu/6502_disasm.hpp>
+#include <cpu/6502_profile.hpp>
 #include <machine/apple_iie.hpp>
-
-#include <goodasm.h>
+#include <machine/apple_iie_video.hpp>
 
 static void glfw_error_callback(int error, const char* description) {
     spdlog::error("GLFW Error {}: {}\n", error, description);
 }
 
+// Disassembly per address, kept until the snapshot shows a write to one
+// of the pages the instruction was decoded from
+class DisasmCache {
+public:
+    struct Line {
+        bool valid = false;
+        uint32_t versions[2];
+        uint8_t len;
+        char text[MOS6502_DISASM_MAX];
+        char bytes[9];
+    };
+
+    DisasmCache() : lines(1 << 16) {}
+
+    const Line &get(const RERunner::Snapshot *snap, uint32_t addr) {
+        const unsigned bits = RAM<uint16_t, uint8_t>::PAGE_BITS;
+        uint32_t first = snap->versions[addr >> bits];
+        uint32_t last = snap->versions[((addr + 2) & 0xFFFF) >> bits];
+
+        Line &line = lines[addr & 0xFFFF];
+        if(line.valid && line.versions[0] == first && line.versions[1] == last)
+            return line;
+
+        uint8_t instr[3];
+        for(int i = 0; i < 3; i++) {
+            instr[i] = snap->mem[(addr + i) & 0xFFFF];
+        }
+        line.len = disasm6502(instr, addr, line.text, sizeof(line.text));
+
+        char *p = line.bytes;
+        for(int i = 0; i < line.len; i++) {
+            p += snprintf(p, line.bytes + sizeof(line.bytes) - p, i ? " %02x" : "%02x", instr[i]);
+        }
+
+        line.valid = true;
+        line.versions[0] = first;
+        line.versions[1] = last;
+        return line;
+    }
+
+private:
+    std::vector<Line> lines;
+};
+
+// Code window rows around PC
+#define CODE_BEFORE 0x40
+#define CODE_ROWS 512
+
+// Memory kept for stepping backwards; always on
+#define REWIND_BUDGET (64 << 20)
+
 class AppState {
 public:
     bool isCPUShown = true;
     bool isStackShown = true;
     bool isMemoryShown = true;
     bool isCodeShown = true;
+    bool isDisplayShown = true;
+    bool isBreakpointsShown = true;
     bool running = false;
 
     REMachine *mach = 0;
+    AppleIIe *apple = 0;
+    RERunner *runner = 0;
     std::map<std::string,Register *> *regs;
-    GoodASM *gas;
+    DisasmCache *disasm;
+
+    // Refreshed once per frame; the windows never touch the machine itself
+    const RERunner::Snapshot *snap = 0;
+
+    int memEdit = -1;
+    bool memEditFocus = false;
+    int memGoto = -1;
+    char memGotoBuf[9] = "";
+
+    std::vector<uint32_t> codeRows;
+    uint32_t codePC = -1;
+
+    // Counted by the CPU while profiling is on, and copied out for the
+    // code rows under the runner lock
+    MOS6502Profile profile;
+    bool profiling = false;
+    std::vector<uint64_t> codeExecs;
+    std::vector<uint64_t> codeCycles;
+
+    AppleIIeVideo video;
+    GLuint displayTex = 0;
+
+    char watchAddr[5] = "";
+    char watchLen[5] = "1";
+    char watchCond[32] = "";
+    bool watchKinds[3] = {false, false, true}; // Read, write, execute
 
     AppState() {
-        mach = new AppleIIe();
+        apple = new AppleIIe();
+        mach = apple;
+        mach->setRewind(REWIND_BUDGET);
+        runner = new RERunner(mach);
         regs = mach->getRegs()->getAll();
-        gas = new GoodASM("6502");
+        disasm = new DisasmCache();
+    }
+
+    uint32_t reg(const char *name) {
+        auto it = regs->find(name);
+        std::size_t i = std::distance(regs->begin(), it);
+        return i < snap->regs.size() ? snap->regs[i] : 0;
+    }
+
+    uint8_t mem(uint32_t addr) {
+        return snap->mem[addr & 0xFFFF];
     }
 };
 
@@ -43,48 +140,58 @@ void CPUWindow(AppState *state) {
 
     ImGui::Begin("CPU", &(state->isCPUShown), ImGuiWindowFlags_AlwaysAutoResize);
     
-    if(ImGui::Button("RESET")) state->mach->reset();
+    if(ImGui::Button("RESET")) state->runner->post({RECommand::RESET, 0, 0});
     ImGui::SameLine();
-    if(ImGui::Button("RUN")) {
-        state->running = !state->running;
-
-        AppleIIe *m = (AppleIIe *)(state->mach);
+    if(ImGui::Button(state->running ? "STOP" : "RUN")) {
         if(state->running) {
-            m->load("/tmp/0", 0);
+            state->runner->pause();
         } else {
-            m->unload();
+            state->runner->run();
         }
-        // state->mach->step();
+        state->running = state->runner->isRunning();
     }
     ImGui::SameLine();
-    if(ImGui::Button("STEP")) state->mach->step();
+    ImGui::BeginDisabled(state->running);
+    if(ImGui::Button("BACK")) state->runner->stepBack(1);
+    ImGui::SameLine();
+    if(ImGui::Button("STEP")) state->runner->step();
+    ImGui::SameLine();
+    // Reverse continue: back to the last breakpoint or watch hit
+    if(ImGui::Button("REWIND")) state->runner->reverseContinue();
+    ImGui::EndDisabled();
+    ImGui::SameLine();
+    bool throttled = state->runner->isThrottled();
+    if(ImGui::Checkbox("Throttle", &throttled)) state->runner->setThrottle(throttled);
 
     if(state->running) {
         ImGui::SameLine();
-        ImGui::Text("Running...");
+        ImGui::Text("Running... %.3f MHz", state->runner->getKHz() / 1000);
     }
 
     ImGui::SeparatorText("Registers");
 
     ImGui::BeginDisabled(state->running);
 
-    for(auto it = state->regs->begin(); it != state->regs->end(); it++) {
+    uint32_t idx = 0;
+    for(auto it = state->regs->begin(); it != state->regs->end(); it++, idx++) {
         std::string name = it->first;
         Register *r = it->second;
+        uint32_t value = idx < state->snap->regs.size() ? state->snap->regs[idx] : 0;
 
         ImGui::Text("%6s", name.c_str());
         ImGui::SameLine();
 
         if(r->disp == Register::BIN && r->help != nullptr) {
+            unsigned int bits = value;
             for(int i = r->width-1; i; i--) {
                 std::string flagname = std::string() + r->help[i];
                 ImGui::PushID(flagname.c_str());
                 if(r->help[i] == '-') {
                     ImGui::BeginDisabled();
-                    ImGui::CheckboxFlags("##", (unsigned int *)r->ptr(), 1<<i);
+                    ImGui::CheckboxFlags("##", &bits, 1<<i);
                     ImGui::EndDisabled();
                 } else {
-                    ImGui::CheckboxFlags("##", (unsigned int *)r->ptr(), 1<<i);
+                    ImGui::CheckboxFlags("##", &bits, 1<<i);
                 }
                 ImGui::PopID();
                 ImGui::SameLine();
@@ -93,12 +200,13 @@ void CPUWindow(AppState *state) {
             ImGui::PushID(flagname.c_str());
             if(r->help[0] == '-') {
                 ImGui::BeginDisabled();
-                ImGui::CheckboxFlags("##", (unsigned int *)r->ptr(), 1);
+                ImGui::CheckboxFlags("##", &bits, 1);
                 ImGui::EndDisabled();
             } else {
-                ImGui::CheckboxFlags("##", (unsigned int *)r->ptr(), 1);
+                ImGui::CheckboxFlags("##", &bits, 1);
             }
             ImGui::PopID();
+            if(bits != value) state->runner->post({RECommand::SET_REG, idx, bits});
 
             ImGui::Text("%6s", name.c_str());
             ImGui::SameLine();
@@ -116,11 +224,12 @@ void CPUWindow(AppState *state) {
 
             // ImGui::PushItemWidth(80);
             ImGui::PushID(name.c_str());
-            ImGui::InputInt("##", (int *)r->ptr(), 0, 0, flags);
+            int val = value;
+            if(ImGui::InputInt("##", &val, 0, 0, flags)) {
+                state->runner->post({RECommand::SET_REG, idx, (uint32_t)val}); // Masked when applied
+            }
             ImGui::PopID();
             // ImGui::PopItemWidth();
-
-            r->set(r->get()); // Fix invalid values
         }
 
     }
@@ -134,34 +243,85 @@ void CodeWindow(AppState *state) {
     if(!state->isCodeShown)
         return;
 
+    // Lay out rows by walking forward from a little before PC. If the walk
+    // lands in the middle of the instruction at PC, resync on PC.
+    uint32_t pc = state->reg("PC");
+    std::vector<uint32_t> &rows = state->codeRows;
+    rows.clear();
+    int pcRow = 0;
+    uint32_t addr = pc > CODE_BEFORE ? pc - CODE_BEFORE : 0;
+    while(rows.size() < CODE_ROWS && addr < state->snap->mem.size()) {
+        if(addr < pc && addr + state->disasm->get(state->snap, addr).len > pc) addr = pc;
+        if(addr == pc) pcRow = rows.size();
+        rows.push_back(addr);
+        addr += state->disasm->get(state->snap, addr).len;
+    }
+
     ImGui::SetNextWindowSize(ImVec2(0, 500));
     ImGui::Begin("Code", &(state->isCodeShown), ImGuiWindowFlags_AlwaysAutoResize);
     ImU32 hl = ImGui::GetColorU32(ImVec4(0.9f, 0.0f, 0.0f, 0.9f));
-    if(ImGui::BeginTable("code", 3, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_BordersV )) {
-        int addr = (**(*state->regs)["PC"]);
-        for(int i = 0; i < 40; i++) {
-            ImGui::TableNextRow();
-            ImGui::TableSetColumnIndex(0);
-            ImGui::Text("%x", addr);
-            if(!i) ImGui::TableSetBgColor(ImGuiTableBgTarget_CellBg, hl);
 
-            state->gas->clear();
-            QByteArray instr = QByteArray();
-            AppleIIe *m = (AppleIIe *)(state->mach);
-            instr.append((*(m->mem))[addr]);
-            instr.append((*(m->mem))[addr+1]);
-            instr.append((*(m->mem))[addr+2]);
-            state->gas->load(instr);
-            QList<GAInstruction> ins = state->gas->instructions;
+    bool profiling = state->profiling;
+    ImGui::Checkbox("Profile", &profiling);
+    ImGui::SameLine();
+    bool clear = ImGui::Button("Clear");
+
+    // Heat is cycles spent at each row, on a log scale against the
+    // hottest row listed
+    std::vector<uint64_t> &execs = state->codeExecs;
+    std::vector<uint64_t> &cycles = state->codeCycles;
+    uint64_t hottest = 0;
+    {
+        auto lock = state->runner->lock();
+        if(profiling != state->profiling) {
+            state->apple->getCPU()->setProfile(profiling ? &state->profile : nullptr);
+            state->profiling = profiling;
+        }
+        if(clear) state->profile.clear();
+
+        execs.resize(rows.size());
+        cycles.resize(rows.size());
+        for(std::size_t i = 0; i < rows.size(); i++) {
+            execs[i] = state->profile.getExecs(rows[i]);
+            cycles[i] = state->profile.getCycles(rows[i]);
+            hottest = std::max(hottest, cycles[i]);
+        }
+    }
+
+    ImVec2 size = ImVec2(0, ImGui::GetTextLineHeightWithSpacing() * 40);
+    if(ImGui::BeginTable("code", 3, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_BordersV, size)) {
+        ImGuiListClipper clipper;
+        clipper.Begin(rows.size());
+        while(clipper.Step()) {
+            // Follow PC whenever it moves
+            if(pc != state->codePC && clipper.ItemsHeight > 0) {
+                ImGui::SetScrollY(clipper.ItemsHeight * pcRow);
+                state->codePC = pc;
+            }
 
-            ImGui::TableSetColumnIndex(1);
-            ImGui::Text("%s %s", ins[0].verb.toStdString().c_str(), ins[0].params.toStdString().c_str());
-            if(!i) ImGui::TableSetBgColor(ImGuiTableBgTarget_CellBg, hl);
+            for(int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+                const DisasmCache::Line &line = state->disasm->get(state->snap, rows[i]);
+
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("%x", rows[i]);
+                if(i == pcRow) {
+                    ImGui::TableSetBgColor(ImGuiTableBgTarget_CellBg, hl);
+                } else if(cycles[i]) {
+                    float heat = log1p((double)cycles[i]) / log1p((double)hottest);
+                    ImGui::TableSetBgColor(ImGuiTableBgTarget_CellBg, ImGui::GetColorU32(ImVec4(1.0f, 0.6f * (1 - heat), 0.0f, 0.2f + 0.6f * heat)));
+                }
+                if(execs[i] && ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("%llu executions, %llu cycles", (unsigned long long)execs[i], (unsigned long long)cycles[i]);
+                }
 
-            ImGui::TableSetColumnIndex(2);
-            QByteArray b = ins[0].data;
-            ImGui::Text("%s", b.toHex(' ').toStdString().c_str());
-            addr += b.length();
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("%s", line.text);
+                if(i == pcRow) ImGui::TableSetBgColor(ImGuiTableBgTarget_CellBg, hl);
+
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%s", line.bytes);
+            }
         }
 
         ImGui::EndTable();
@@ -175,26 +335,63 @@ void MemoryWindow(AppState *state) {
 
     ImGui::SetNextWindowSize(ImVec2(0, 800));
     ImGui::Begin("Memory", &(state->isMemoryShown), ImGuiWindowFlags_AlwaysAutoResize);
-    if(ImGui::BeginTable("Memory", 17, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders | ImGuiTableFlags_ScrollY )) {
-        for(int i = 0; i < 1 << 16; i += 16) {
-            ImGui::TableNextRow();
 
-            ImGui::TableSetColumnIndex(0);
-            ImGui::Text("%04x", i);
-        
-            for(int j = 0; j < 16; j++) {
-                ImGui::TableSetColumnIndex(j+1);
-                AppleIIe *m = (AppleIIe *)(state->mach);
-                ImGui::PushID(i+j);
-                // ImGui::Text("%02x", (*(m->mem))[i+j]);
-                ImGui::PushItemWidth(22);
-                ImGui::InputScalar("##mem", ImGuiDataType_U8, (int *)m->mem->ptr(i+j), NULL, NULL, "%02X", ImGuiInputTextFlags_CharsUppercase );
-                ImGui::PopItemWidth();
-                ImGui::PopID();
+    ImGui::PushItemWidth(80);
+    if(ImGui::InputText("Goto", state->memGotoBuf, sizeof(state->memGotoBuf), ImGuiInputTextFlags_CharsHexadecimal | ImGuiInputTextFlags_EnterReturnsTrue)) {
+        state->memGoto = strtoul(state->memGotoBuf, NULL, 16);
+    }
+    ImGui::PopItemWidth();
+
+    // Only the visible rows are submitted, and only the cell being edited
+    // is an input widget, so the cost per frame does not depend on the
+    // size of the address space
+    int rows = state->snap->mem.size() / 16;
+    ImVec2 size = ImVec2(0, ImGui::GetTextLineHeightWithSpacing() * 40);
+    if(ImGui::BeginTable("Memory", 17, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders | ImGuiTableFlags_ScrollY, size)) {
+        ImGuiListClipper clipper;
+        clipper.Begin(rows);
+        if(state->memEdit >= 0) clipper.IncludeItemByIndex(state->memEdit / 16);
+
+        while(clipper.Step()) {
+            if(state->memGoto >= 0 && clipper.ItemsHeight > 0) {
+                ImGui::SetScrollY(clipper.ItemsHeight * (state->memGoto / 16));
+                state->memGoto = -1;
+            }
+
+            for(int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+                int i = row * 16;
+                ImGui::TableNextRow();
+
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("%04x", i);
+
+                for(int j = 0; j < 16; j++) {
+                    ImGui::TableSetColumnIndex(j+1);
+                    uint8_t val = state->mem(i+j);
+
+                    if(state->memEdit != i+j) {
+                        ImGui::Text("%02X", val);
+                        if(ImGui::IsItemClicked()) {
+                            state->memEdit = i+j;
+                            state->memEditFocus = true;
+                        }
+                        continue;
+                    }
+
+                    ImGui::PushID(i+j);
+                    ImGui::PushItemWidth(22);
+                    if(state->memEditFocus) {
+                        ImGui::SetKeyboardFocusHere();
+                        state->memEditFocus = false;
+                    }
+                    if(ImGui::InputScalar("##mem", ImGuiDataType_U8, &val, NULL, NULL, "%02X", ImGuiInputTextFlags_CharsUppercase | ImGuiInputTextFlags_EnterReturnsTrue)) {
+                        state->runner->post({RECommand::WRITE_MEM, (uint32_t)(i+j), val});
+                    }
+                    if(ImGui::IsItemDeactivated()) state->memEdit = -1;
+                    ImGui::PopItemWidth();
+                    ImGui::PopID();
+                }
             }
-            // ImGui::PushID(addr);
-            // int flags = ImGuiInputTextFlags_CharsUppercase | ImGuiInputTextFlags_CharsHexadecimal;
-            // ImGui::PopID();
         }
         ImGui::EndTable();
     }
@@ -216,21 +413,23 @@ void StackWindow(AppState *state) {
 
             ImGui::TableSetColumnIndex(0);
             ImGui::Text("%x", addr);
-            if(addr == (**(*state->regs)["SP"])) {
+            if((uint32_t)addr == state->reg("SP")) {
                 ImGui::TableSetBgColor(ImGuiTableBgTarget_CellBg, hl);
             }
         
             ImGui::TableSetColumnIndex(1);
             ImGui::PushID(addr);
             int flags = ImGuiInputTextFlags_CharsUppercase | ImGuiInputTextFlags_CharsHexadecimal;
-            AppleIIe *m = (AppleIIe *)(state->mach);
             ImGui::PushItemWidth(22);
             // ImGui::InputInt("##stack", (int *)m->mem->ptr(addr),0, 0, flags);
-            ImGui::InputScalar("##stack", ImGuiDataType_U8, (int *)m->mem->ptr(addr), NULL, NULL, "%02x", ImGuiInputTextFlags_CharsUppercase );
+            uint8_t val = state->mem(addr);
+            if(ImGui::InputScalar("##stack", ImGuiDataType_U8, &val, NULL, NULL, "%02x", ImGuiInputTextFlags_CharsUppercase )) {
+                state->runner->post({RECommand::WRITE_MEM, (uint32_t)addr, val});
+            }
             ImGui::PopItemWidth();
             ImGui::PopID();
 
-            if(addr == (**(*state->regs)["SP"])) {
+            if((uint32_t)addr == state->reg("SP")) {
                 ImGui::TableSetBgColor(ImGuiTableBgTarget_CellBg, hl);
             }
         }
@@ -240,6 +439,141 @@ void StackWindow(AppState *state) {
     ImGui::End();
 }    
 
+// Conditions are "NAME==VALUE" in hex, where NAME is a register or "data"
+// for the byte accessed. Empty means always. Registers are compared once
+// the instruction has finished, so PC is the next instruction's (or the
+// instruction itself, for an X watch) rather than wherever the CPU was
+// mid-fetch.
+static bool parseCondition(AppState *state, const char *text, std::function<bool(uint16_t, uint8_t)> &cond,
+    std::function<bool()> &after) {
+    cond = nullptr;
+    after = nullptr;
+    if(!*text) return true;
+
+    const char *eq = strstr(text, "==");
+    if(!eq || !eq[2]) return false;
+    std::string name(text, eq - text);
+    char *end;
+    uint32_t value = strtoul(eq + 2, &end, 16);
+    if(*end) return false;
+
+    if(name == "data") {
+        cond = [value](uint16_t, uint8_t data) { return data == value; };
+        return true;
+    }
+    auto it = state->regs->find(name);
+    if(it == state->regs->end()) return false;
+    Register *r = it->second;
+    after = [r, value]() { return r->get() == value; };
+    return true;
+}
+
+void BreakpointsWindow(AppState *state) {
+    if(!state->isBreakpointsShown)
+        return;
+
+    typedef RAM<uint16_t, uint8_t> Mem;
+    Mem *mem = state->mach->getMem();
+
+    ImGui::Begin("Breakpoints", &(state->isBreakpointsShown), ImGuiWindowFlags_AlwaysAutoResize);
+
+    ImGui::PushItemWidth(50);
+    ImGui::InputText("Addr", state->watchAddr, sizeof(state->watchAddr), ImGuiInputTextFlags_CharsHexadecimal);
+    ImGui::SameLine();
+    ImGui::InputText("Len", state->watchLen, sizeof(state->watchLen), ImGuiInputTextFlags_CharsHexadecimal);
+    ImGui::PopItemWidth();
+    ImGui::SameLine();
+    ImGui::Checkbox("R", &state->watchKinds[0]);
+    ImGui::SameLine();
+    ImGui::Checkbox("W", &state->watchKinds[1]);
+    ImGui::SameLine();
+    ImGui::Checkbox("X", &state->watchKinds[2]);
+    ImGui::PushItemWidth(160);
+    ImGui::InputTextWithHint("##cond", "A==10, data==FF", state->watchCond, sizeof(state->watchCond));
+    ImGui::PopItemWidth();
+    ImGui::SameLine();
+
+    uint8_t kinds = (state->watchKinds[0] ? Mem::WATCH_READ : 0) | (state->watchKinds[1] ? Mem::WATCH_WRITE : 0) |
+                    (state->watchKinds[2] ? Mem::WATCH_EXEC : 0);
+    std::function<bool(uint16_t, uint8_t)> cond;
+    std::function<bool()> after;
+    bool valid = *state->watchAddr && kinds && parseCondition(state, state->watchCond, cond, after);
+    ImGui::BeginDisabled(!valid);
+    if(ImGui::Button("Add")) {
+        auto lock = state->runner->lock();
+        mem->watch(strtoul(state->watchAddr, NULL, 16), std::max(1ul, strtoul(state->watchLen, NULL, 16)), kinds,
+            cond, after);
+    }
+    ImGui::EndDisabled();
+
+    // The emulation thread checks these, so even reading them takes the lock
+    auto lock = state->runner->lock();
+    uint32_t removed = 0;
+    if(ImGui::BeginTable("watches", 4, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersV)) {
+        for(auto &w : mem->getWatches()) {
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            ImGui::Text("%04x-%04x", w.addr, (uint32_t)(w.addr + w.n - 1));
+            ImGui::TableSetColumnIndex(1);
+            ImGui::Text("%c%c%c", w.kinds & Mem::WATCH_READ ? 'R' : '-', w.kinds & Mem::WATCH_WRITE ? 'W' : '-',
+                w.kinds & Mem::WATCH_EXEC ? 'X' : '-');
+            ImGui::TableSetColumnIndex(2);
+            ImGui::Text("%s", w.cond || w.after ? "if" : "");
+            ImGui::TableSetColumnIndex(3);
+            ImGui::PushID(w.id);
+            if(ImGui::SmallButton("Delete")) removed = w.id;
+            ImGui::PopID();
+        }
+        ImGui::EndTable();
+    }
+    if(removed) mem->unwatch(removed);
+
+    if(mem->stopped()) {
+        const Mem::Hit &hit = mem->lastHit();
+        const char *kind = hit.kind == Mem::WATCH_READ ? "Read" : hit.kind == Mem::WATCH_WRITE ? "Write" : "Execute";
+        ImGui::Text("%s hit at %04x (%02x)", kind, hit.addr, hit.data);
+    }
+
+    ImGui::End();
+}
+
+void DisplayWindow(AppState *state) {
+    if(!state->isDisplayShown)
+        return;
+
+    // The screen shows main memory, but the snapshot has the address space
+    // as the CPU sees it, which RAMRD or 80STORE may point at aux. So this
+    // draws from the main block under the runner lock, along with reading
+    // the display switches, which are not in the snapshot either. Only
+    // lines that changed are redrawn, which keeps the lock short.
+    int top, bottom;
+    bool changed;
+    {
+        auto lock = state->runner->lock();
+        bool flash = fmod(ImGui::GetTime(), 0.5) < 0.25;
+        AppleIIeVideo::Mode mode = AppleIIeVideo::mode(state->apple->io.s, state->apple->mmu.s, flash);
+        RAM<uint16_t, uint8_t> *mem = state->apple->getMem();
+        changed = state->video.update(mem->block("main"), mem->versionPtr(0), mode, top, bottom);
+    }
+    const uint32_t *pixels = state->video.pixels();
+
+    if(!state->displayTex) {
+        glGenTextures(1, &state->displayTex);
+        glBindTexture(GL_TEXTURE_2D, state->displayTex);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, AppleIIeVideo::WIDTH, AppleIIeVideo::HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    } else if(changed) {
+        // Only the lines that were redrawn
+        glBindTexture(GL_TEXTURE_2D, state->displayTex);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, top, AppleIIeVideo::WIDTH, bottom - top, GL_RGBA, GL_UNSIGNED_BYTE, pixels + top * AppleIIeVideo::WIDTH);
+    }
+
+    ImGui::Begin("Display", &(state->isDisplayShown), ImGuiWindowFlags_AlwaysAutoResize);
+    ImGui::Image((ImTextureID)(intptr_t)state->displayTex, ImVec2(AppleIIeVideo::WIDTH * 2, AppleIIeVideo::HEIGHT * 2));
+    ImGui::End();
+}
+
 void mainLoop(AppState *state) {
     if(ImGui::BeginMainMenuBar()){
         if(ImGui::BeginMenu("View")) {
@@ -247,15 +581,22 @@ void mainLoop(AppState *state) {
             if(ImGui::MenuItem("Stack", NULL, state->isStackShown, true)) { state->isStackShown ^= 1; }
             if(ImGui::MenuItem("Memory", NULL, state->isMemoryShown, true)) { state->isMemoryShown ^= 1; }
             if(ImGui::MenuItem("Code", NULL, state->isCodeShown, true)) { state->isCodeShown ^= 1; }
+            if(ImGui::MenuItem("Display", NULL, state->isDisplayShown, true)) { state->isDisplayShown ^= 1; }
+            if(ImGui::MenuItem("Breakpoints", NULL, state->isBreakpointsShown, true)) { state->isBreakpointsShown ^= 1; }
             ImGui::EndMenu();
         }
         ImGui::EndMainMenuBar();
     }
 
+    state->snap = &state->runner->snapshot();
+    state->running = state->runner->isRunning();
+
     CPUWindow(state);
     StackWindow(state);
     MemoryWindow(state);
     CodeWindow(state);
+    DisplayWindow(state);
+    BreakpointsWindow(state);
 }
 
 int startGui(AppState *state) {
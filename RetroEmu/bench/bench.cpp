@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+#include <common/batch.hpp>
+#include <common/ram.hpp>
+#include <common/registers.hpp>
+#include <cpu/6502.hpp>
+#include <machine/apple_iie.hpp>
+#include <test/programs.hpp>
+
+// Microbenchmarks for the paths every emulated instruction goes through.
+// Results are written to RetroEmuBench.json as well as the console unless
+// --benchmark_out says otherwise; compare two runs with Google
+// Benchmark's tools/compare.py. "emuHz" is emulated cycles per second.
+
+// RAM split into n equal regions. Above 256 they are smaller than a page,
+// which leaves every access to the slow path.
+static void mapRegions(RAM<uint16_t, uint8_t> &mem, std::vector<uint8_t> &buf, std::size_t n) {
+    std::size_t size = 0x10000 / n;
+    for(std::size_t i = 0; i < n; i++) mem.mapBuf("", i * size, size, buf.data() + i * size, true);
+}
+
+static void RamRead(benchmark::State &state) {
+    std::vector<uint8_t> buf(0x10000);
+    RAM<uint16_t, uint8_t> mem;
+    mapRegions(mem, buf, state.range(0));
+
+    uint16_t addr = 0;
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(mem.read(addr));
+        addr += 7;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(RamRead)->ArgName("regions")->RangeMultiplier(16)->Range(1, 4096);
+
+static void RamWrite(benchmark::State &state) {
+    std::vector<uint8_t> buf(0x10000);
+    RAM<uint16_t, uint8_t> mem;
+    mapRegions(mem, buf, state.range(0));
+
+    uint16_t addr = 0;
+    for(auto _ : state) {
+        mem.write(addr, addr);
+        addr += 7;
+    }
+    benchmark::DoNotOptimize(buf.data());
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(RamWrite)->ArgName("regions")->RangeMultiplier(16)->Range(1, 4096);
+
+// The decoder RAM replaced, for reference: a reverse scan over the memmap
+// for every access
+class LinearRAM {
+public:
+    typedef std::tuple<uint16_t, std::size_t, uint8_t *> memmapEntry;
+    std::vector<memmapEntry> memmap;
+
+    void mapBuf(const char *, uint16_t addr, std::size_t size, uint8_t *buf, bool = false) {
+        memmap.push_back({addr, size, buf});
+    }
+
+    uint8_t read(uint16_t addr) {
+        auto iter = std::find_if(memmap.rbegin(), memmap.rend(), [&addr](const memmapEntry &x) {
+            uint16_t addr_begin = std::get<0>(x);
+            uint16_t addr_end = addr_begin + std::get<1>(x) - 1;
+            return (addr_begin <= addr) && (addr <= addr_end);
+        });
+        if(iter == memmap.rend()) return 0;
+        return std::get<2>(*iter)[addr - std::get<0>(*iter)];
+    }
+};
+
+// Laid out as the AppleIIe maps it: flat RAM, a loaded program and the
+// monitor ROM
+template <typename M>
+static void RamReadLayout(benchmark::State &state) {
+    static uint8_t ram[0xF800], prog[0x100], rom[0x800];
+    M mem;
+    mem.mapBuf("", 0, sizeof(ram), ram, true);
+    mem.mapBuf("test", 0x0800, sizeof(prog), prog, true);
+    mem.mapBuf("monitor", 0xF800, sizeof(rom), rom);
+
+    uint16_t addr = 0;
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(mem.read(addr));
+        addr += 7;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(RamReadLayout<LinearRAM>)->Name("RamReadLayout/linear");
+BENCHMARK(RamReadLayout<RAM<uint16_t, uint8_t>>)->Name("RamReadLayout/paged");
+
+// By name, as the debugger and CLI look registers up
+static void RegistersLookup(benchmark::State &state) {
+    RAM<uint16_t, uint8_t> mem;
+    MOS6502 cpu(&mem);
+    Registers &regs = *cpu.getRegs();
+
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(regs["PC"]);
+        benchmark::DoNotOptimize(regs["Y"]);
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(RegistersLookup);
+
+// A loop of one class of instructions at $0400, ending in a JMP back
+struct OpcodeClass {
+    const char *name;
+    std::vector<uint8_t> body;
+};
+
+static const OpcodeClass CLASSES[] = {
+    {"load", {0xA9, 0x12, 0xA6, 0x10, 0xBC, 0x00, 0x03, 0xB1, 0x20}},       // LDA # / LDX zp / LDY abs,X / LDA (zp),Y
+    {"store", {0x85, 0x10, 0x8E, 0x00, 0x03, 0x94, 0x11, 0x91, 0x20}},      // STA zp / STX abs / STY zp,X / STA (zp),Y
+    {"alu", {0x69, 0x01, 0x29, 0x7F, 0x05, 0x10, 0x49, 0x55, 0xC9, 0x40}},  // ADC # / AND # / ORA zp / EOR # / CMP #
+    {"rmw", {0xE6, 0x10, 0x06, 0x11, 0x6E, 0x00, 0x03, 0xDE, 0x00, 0x03}},  // INC zp / ASL zp / ROR abs / DEC abs,X
+    {"branch", {0x18, 0x90, 0x00, 0xB0, 0x00, 0xD0, 0x00, 0xF0, 0x00}},    // CLC / BCC / BCS / BNE / BEQ, all to the next
+    {"call", {0x20, 0x80, 0x04}},                                           // JSR to an RTS
+    {"stack", {0x48, 0x08, 0x28, 0x68}},                                    // PHA / PHP / PLP / PLA
+    {"decimal", {0xF8, 0x69, 0x19, 0xE9, 0x07, 0xD8}},                      // SED / ADC # / SBC # / CLD
+};
+
+struct Machine {
+    RAM<uint16_t, uint8_t> mem;
+    MOS6502 cpu;
+
+    Machine(const OpcodeClass &c, MOS6502::Core core) : cpu(&mem, core) {
+        mem.mapMem("ram", 0, 0x10000, true);
+        uint16_t pc = 0x0400;
+        for(int i = 0; i < 8; i++) {
+            for(uint8_t b : c.body) mem.write(pc++, b);
+        }
+        mem.write(pc++, 0x4C); // JMP $0400
+        mem.write(pc++, 0x00);
+        mem.write(pc++, 0x04);
+        mem.write(0x0480, 0x60); // RTS
+        mem.write(0x20, 0x00);   // ($20) points at $0300
+        mem.write(0x21, 0x03);
+        mem.write(0xFFFC, 0x00);
+        mem.write(0xFFFD, 0x04);
+        cpu.step();
+    }
+};
+
+static void countCycles(benchmark::State &state, uint64_t cycles, uint64_t instructions) {
+    state.SetItemsProcessed(instructions);
+    state.counters["emuHz"] = benchmark::Counter(cycles, benchmark::Counter::kIsRate);
+}
+
+// One step() per instruction, as a debugger single-steps
+static void Step(benchmark::State &state, const OpcodeClass &c, MOS6502::Core core) {
+    Machine m(c, core);
+    uint64_t start = m.cpu.getCycles();
+    for(auto _ : state) m.cpu.step();
+    countCycles(state, m.cpu.getCycles() - start, state.iterations());
+}
+
+// Long runs, as the machines run when nothing is watching
+static void Run(benchmark::State &state, const OpcodeClass &c, MOS6502::Core core) {
+    Machine m(c, core);
+    uint64_t start = m.cpu.getCycles();
+    for(auto _ : state) m.cpu.run(1000);
+    countCycles(state, m.cpu.getCycles() - start, state.iterations() * 1000);
+}
+
+static const char *CORE_NAMES[] = {"switch", "table", "trace"};
+
+static void registerCpu() {
+    for(const OpcodeClass &c : CLASSES) {
+        for(int core = MOS6502::CORE_SWITCH; core <= MOS6502::CORE_TRACE; core++) {
+            // The switch core ignores the D flag, so it would be timing
+            // binary arithmetic under the decimal name
+            if(core == MOS6502::CORE_SWITCH && !strcmp(c.name, "decimal")) continue;
+            std::string suffix = std::string(c.name) + "/" + CORE_NAMES[core];
+            benchmark::RegisterBenchmark(("Step/" + suffix).c_str(), Step, c, (MOS6502::Core)core);
+            benchmark::RegisterBenchmark(("Run/" + suffix).c_str(), Run, c, (MOS6502::Core)core);
+        }
+    }
+}
+
+// WORKLOAD from the tests. Decimal mode makes it meaningless on the
+// switch core, so it only runs on the other two
+static void Workload(benchmark::State &state, MOS6502::Core core) {
+    RAM<uint16_t, uint8_t> mem;
+    MOS6502 cpu(&mem, core);
+    loadWorkload(mem);
+
+    uint64_t start = cpu.getCycles();
+    for(auto _ : state) cpu.run(1000);
+    countCycles(state, cpu.getCycles() - start, state.iterations() * 1000);
+}
+BENCHMARK_CAPTURE(Workload, table, MOS6502::CORE_TABLE);
+BENCHMARK_CAPTURE(Workload, trace, MOS6502::CORE_TRACE);
+
+// Runs from the reset vector, so a real monitor ROM spends its time in
+// the keyboard loop, polling the I/O page
+static void AppleIIeStep(benchmark::State &state, std::shared_ptr<std::vector<uint8_t>> rom) {
+    AppleIIe m(rom->data(), rom->size());
+    uint64_t start = m.getCycles();
+    for(auto _ : state) m.step();
+    countCycles(state, m.getCycles() - start, state.iterations());
+}
+
+static void AppleIIeRun(benchmark::State &state, std::shared_ptr<std::vector<uint8_t>> rom) {
+    AppleIIe m(rom->data(), rom->size());
+    uint64_t start = m.getCycles();
+    for(auto _ : state) m.run(1000);
+    countCycles(state, m.getCycles() - start, state.iterations() * 1000);
+}
+
+// Many machines at once through REBatch, each storing its own input byte
+// ($00) from the stand-in ROM; the second argument is threads, 0 for one
+// per core
+static void Batch(benchmark::State &state) {
+    static const std::vector<uint8_t> rom = standInRom();
+    REBatch batch(state.range(0), [](std::size_t i) {
+        AppleIIe *m = new AppleIIe(rom.data(), rom.size());
+        m->getMem()->write(0x00, i);
+        return m;
+    }, state.range(1));
+
+    uint64_t instructions = 0, cycles = 0;
+    for(auto _ : state) {
+        REBatch::Stats stats = batch.run(1000);
+        instructions += stats.instructions;
+        cycles += stats.cycles;
+    }
+    countCycles(state, cycles, instructions);
+}
+BENCHMARK(Batch)->ArgNames({"machines", "threads"})->Args({4096, 1})->Args({4096, 0})->UseRealTime();
+
+// ROM images from $RETROEMU_BENCH_ROM, a colon-separated list of files
+// mapped up to $FFFF, e.g. the 2K monitor or the whole 16K of the IIe
+static void registerAppleIIe() {
+    std::vector<std::pair<std::string, std::shared_ptr<std::vector<uint8_t>>>> roms;
+    roms.push_back({"standin", std::make_shared<std::vector<uint8_t>>(standInRom())});
+
+    const char *env = getenv("RETROEMU_BENCH_ROM");
+    std::string paths = env ? env : "";
+    std::size_t at = 0;
+    while(at < paths.size()) {
+        std::size_t end = paths.find(':', at);
+        if(end == std::string::npos) end = paths.size();
+        std::string path = paths.substr(at, end - at);
+        at = end + 1;
+
+        std::ifstream file(path, std::ios::binary);
+        auto rom = std::make_shared<std::vector<uint8_t>>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if(rom->empty() || rom->size() > 0x4000) {
+            fprintf(stderr, "Skipping ROM %s: missing, empty or over 16K\n", path.c_str());
+            continue;
+        }
+        roms.push_back({path.substr(path.find_last_of('/') + 1), rom});
+    }
+
+    for(auto &[name, rom] : roms) {
+        benchmark::RegisterBenchmark(("AppleIIeStep/" + name).c_str(), AppleIIeStep, rom);
+        benchmark::RegisterBenchmark(("AppleIIeRun/" + name).c_str(), AppleIIeRun, rom);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<char *> args(argv, argv + argc);
+    bool out = false;
+    for(char *arg : args) {
+        if(!strncmp(arg, "--benchmark_out=", 16)) out = true;
+    }
+    char outFile[] = "--benchmark_out=RetroEmuBench.json";
+    char outFormat[] = "--benchmark_out_format=json";
+    if(!out) {
+        args.push_back(outFile);
+        args.push_back(outFormat);
+    }
+    int n = args.size();
+
+    registerCpu();
+    registerAppleIIe();
+    benchmark::Initialize(&n, args.data());
+    if(benchmark::ReportUnrecognizedArguments(n, args.data())) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
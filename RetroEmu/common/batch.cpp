@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <chrono>
+
+#include <common/batch.hpp>
+
+REBatch::REBatch(std::size_t n, std::function<REMachine *(std::size_t)> make, unsigned threads)
+    : threads(threads ? threads : std::max(1u, std::thread::hardware_concurrency())) {
+    machines.reserve(n);
+    for(std::size_t i = 0; i < n; i++) {
+        machines.emplace_back(make(i));
+    }
+
+    // No point in more workers than machines
+    unsigned workers = std::min<std::size_t>(this->threads, std::max<std::size_t>(n, 1));
+    shares = std::vector<Share>(workers);
+    for(unsigned w = 1; w < workers; w++) {
+        pool.emplace_back(&REBatch::serve, this, w);
+    }
+}
+
+REBatch::~REBatch() {
+    {
+        std::lock_guard<std::mutex> l(m);
+        quit = true;
+    }
+    wake.notify_all();
+    for(auto &t : pool) {
+        t.join();
+    }
+}
+
+std::size_t REBatch::size() {
+    return machines.size();
+}
+
+REMachine *REBatch::operator[](std::size_t i) {
+    return machines[i].get();
+}
+
+// Worker w's loop: sleeps until the next run, works, reports back
+void REBatch::serve(unsigned w) {
+    uint64_t seen = 0;
+    while(true) {
+        {
+            std::unique_lock<std::mutex> l(m);
+            wake.wait(l, [&] { return quit || generation != seen; });
+            if(quit) return;
+            seen = generation;
+        }
+        work(w);
+        {
+            std::lock_guard<std::mutex> l(m);
+            busy--;
+        }
+        done.notify_one();
+    }
+}
+
+void REBatch::work(unsigned w) {
+    unsigned workers = shares.size();
+    Share &own = shares[w];
+
+    // Own share first, then the others' leftovers. Claims are a single
+    // fetch_add, so the owner and thieves never hand out a machine twice.
+    for(unsigned k = 0; k < workers; k++) {
+        Share &from = shares[(w + k) % workers];
+        std::size_t i;
+        while((i = from.next.fetch_add(1, std::memory_order_relaxed)) < from.end) {
+            REMachine *mach = machines[i].get();
+            uint64_t start = mach->getCycles();
+            own.instructions += mach->run(steps);
+            own.cycles += mach->getCycles() - start;
+        }
+    }
+}
+
+REBatch::Stats REBatch::run(uint64_t n) {
+    std::size_t count = machines.size();
+    unsigned workers = shares.size();
+    for(unsigned w = 0; w < workers; w++) {
+        shares[w].next = count * w / workers;
+        shares[w].end = count * (w + 1) / workers;
+        shares[w].instructions = 0;
+        shares[w].cycles = 0;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    // The mutex publishes the shares and n to the workers along with the
+    // new generation, and their results back with busy
+    {
+        std::lock_guard<std::mutex> l(m);
+        steps = n;
+        busy = pool.size();
+        generation++;
+    }
+    wake.notify_all();
+    work(0);
+    {
+        std::unique_lock<std::mutex> l(m);
+        done.wait(l, [&] { return busy == 0; });
+    }
+
+    std::chrono::duration<double> t = std::chrono::steady_clock::now() - start;
+
+    Stats stats = {0, 0, t.count()};
+    for(Share &s : shares) {
+        stats.instructions += s.instructions;
+        stats.cycles += s.cycles;
+    }
+    return stats;
+}
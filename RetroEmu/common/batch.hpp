@@ -0,0 +1,74 @@
+#ifndef __BATCH_HPP
+#define __BATCH_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <common/machine.hpp>
+
+// Many independent machines run side by side, e.g. one program against
+// thousands of inputs. Machines share nothing mutable, so each run() hands
+// them out to worker threads without locking: every worker starts on its
+// own contiguous share and, once that is done, steals whatever is left in
+// the others'. The workers are started once, with the batch, and the
+// calling thread works alongside them.
+class REBatch {
+public:
+    struct Stats {
+        uint64_t instructions;
+        uint64_t cycles;
+        double seconds;
+
+        double instructionsPerSecond() { return seconds > 0 ? instructions / seconds : 0; }
+    };
+
+    // make(i) builds machine i with new; the batch owns it from then on.
+    // threads of 0 uses one per core.
+    REBatch(std::size_t n, std::function<REMachine *(std::size_t)> make, unsigned threads = 0);
+    ~REBatch();
+
+    REBatch(const REBatch &) = delete;
+    REBatch &operator=(const REBatch &) = delete;
+
+    std::size_t size();
+    REMachine *operator[](std::size_t i);
+
+    // Runs every machine for up to n instructions and returns the totals.
+    // Only one thread may run a batch at a time.
+    Stats run(uint64_t n);
+
+private:
+    std::vector<std::unique_ptr<REMachine>> machines;
+    unsigned threads;
+
+    // One per worker, padded so workers never write to the same cache line
+    struct alignas(64) Share {
+        std::atomic<std::size_t> next;
+        std::size_t end;
+        uint64_t instructions;
+        uint64_t cycles;
+    };
+    std::vector<Share> shares;
+
+    // Workers 1 and up; the caller of run() is worker 0. Each run bumps
+    // generation to wake them, and waits for busy to drop back to 0.
+    std::vector<std::thread> pool;
+    std::mutex m;
+    std::condition_variable wake;
+    std::condition_variable done;
+    uint64_t generation = 0;
+    unsigned busy = 0;
+    bool quit = false;
+    uint64_t steps = 0; // n for the current run
+
+    void work(unsigned w);
+    void serve(unsigned w);
+};
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef __CPU_HPP
 #define __CPU_HPP
 
+#include <cstdint>
 #include <common/ram.hpp>
 #include <common/registers.hpp>
 
@@ -8,9 +9,22 @@ template <typename I, typename D>
 class RECPU {
 public:
     // RECPU(RAM<I,D> *);
+    virtual ~RECPU() = default;
+
     virtual void step() = 0;
     virtual void reset() = 0;
     virtual Registers *getRegs() = 0;
+
+    // Runs whole instructions until at least n cycles have elapsed and
+    // returns the number of cycles actually run.
+    virtual uint64_t runCycles(uint64_t n) = 0;
+
+    // Cycles elapsed since construction
+    uint64_t getCycles() { return cycles; }
+
+protected:
+    uint64_t cycles = 0;
+
 private:
     RAM<I,D> *mem;
 };
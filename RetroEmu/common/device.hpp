@@ -0,0 +1,19 @@
+#ifndef __DEVICE_HPP
+#define __DEVICE_HPP
+
+// Something on the bus with side effects, mapped into RAM with mapDev().
+// Accesses get the full address, so one device can decode a whole range
+// of soft switches.
+template <typename A, typename D>
+class REDevice {
+public:
+    virtual ~REDevice() {}
+
+    virtual D read(A addr) = 0;
+    virtual void write(A addr, D data) = 0;
+
+    // For debuggers and snapshots: must not change anything
+    virtual D peek(A) { return 0; }
+};
+
+#endif
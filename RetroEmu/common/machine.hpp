@@ -1,14 +1,46 @@
 #ifndef __MACHINE_HPP
 #define __MACHINE_HPP
 
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <common/ram.hpp>
 #include <common/registers.hpp>
 
 class REMachine {
 public:
     // REMACHINE();
+    virtual ~REMachine() = default;
+
     virtual void step() = 0;
+    // Up to n whole instructions; returns how many ran, fewer if a watch
+    // stopped it
+    virtual uint64_t run(uint64_t n) = 0;
     virtual void reset() = 0;
     virtual Registers *getRegs() = 0;
+    virtual RAM<uint16_t, uint8_t> *getMem() = 0;
+
+    virtual uint64_t runCycles(uint64_t n) = 0;
+    virtual uint64_t getCycles() = 0;
+    virtual uint32_t getClockKHz() = 0;
+
+    virtual void saveState(std::vector<uint8_t> &out) = 0;
+    virtual bool loadState(const std::vector<uint8_t> &in) = 0;
+
+    // Returns an independent copy of the machine. Memory is shared
+    // copy-on-write, so the cost grows with the pages either side writes
+    // rather than with the size of memory. Null if memory could not be
+    // imaged.
+    virtual std::unique_ptr<REMachine> fork() = 0;
+
+    // Reverse execution: history is recorded within budget bytes (0 turns
+    // it off), and stepBack() undoes up to n instructions, returning how
+    // many it could. reverseContinue() goes back to the last watch hit
+    // before the current point, or to the start of history.
+    virtual void setRewind(std::size_t budget) = 0;
+    virtual uint64_t stepBack(uint64_t n) = 0;
+    virtual uint64_t reverseContinue() = 0;
+    virtual uint64_t rewindDepth() = 0;
 private:
 };
 
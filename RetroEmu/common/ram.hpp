@@ -7,11 +7,19 @@
 #include <algorithm>
 #include <format>
 #include <fstream>
+#include <functional>
+#include <memory>
 #include <fcntl.h>
+#include <unistd.h>
 #include <sys/mman.h>
 #include <spdlog/spdlog.h>
 #include <cstring>
 
+#include <common/device.hpp>
+#include <common/rom.hpp>
+#include <common/state.hpp>
+#include <common/rewind.hpp>
+
 #include <iostream>
 template<class TupType, size_t... I>
 void print(const TupType& _tup, std::index_sequence<I...>)
@@ -40,110 +48,355 @@ public:
 template <typename A, typename D>
 class RAM {
 public:
+    // Accesses are decoded through a flat table of PAGE_SIZE pages, so the
+    // table has one entry per page of the A address space.
+    static constexpr unsigned PAGE_BITS = 8;
+    static constexpr std::size_t PAGE_SIZE = 1 << PAGE_BITS;
+    static constexpr std::size_t PAGE_MASK = PAGE_SIZE - 1;
+    static constexpr std::size_t PAGE_COUNT = ((std::size_t)1 << (sizeof(A) * 8)) >> PAGE_BITS;
+
+    // Address, size, buffer, writable, ID, and the device for I/O ranges.
+    // Banked ranges have neither buffer nor device.
+    typedef std::tuple<A, std::size_t, D *, bool, const char *, REDevice<A, D> *> memmapEntry;
+
+    // Kinds of access a watch can catch
+    static constexpr uint8_t WATCH_READ = 1;
+    static constexpr uint8_t WATCH_WRITE = 2;
+    static constexpr uint8_t WATCH_EXEC = 4;
+
+    // n bytes from addr. Only hits when cond is null or returns true for
+    // the address and the byte read, written or about to be executed.
+    // after, if set, is asked once the instruction that hit has finished
+    // (before it runs, for EXEC), so it sees whole-instruction state such
+    // as the CPU's registers; the hit is dropped if it returns false.
+    struct Watch {
+        uint32_t id;
+        A addr;
+        std::size_t n;
+        uint8_t kinds;
+        std::function<bool(A, D)> cond;
+        std::function<bool()> after;
+    };
+
+    struct Hit {
+        uint32_t id;
+        A addr;
+        uint8_t kind;
+        D data;
+    };
+
+    // Frozen copy of a memory map. Writable regions live in one sealed
+    // memfd, each at a host-page-aligned offset, so any number of RAMs can
+    // map them copy-on-write; read-only regions are shared by pointer, and
+    // kept alive by the image. Devices are shared as well, so a fork that
+    // needs its own has to map it over the top.
+    struct Image {
+        int fd = -1;
+        std::vector<memmapEntry> memmap;
+        std::vector<off_t> offsets; // -1 for read-only entries
+        std::vector<std::shared_ptr<void>> backing;
+        std::vector<memmapEntry> blocks;
+        std::vector<off_t> blockOffsets;
+
+        ~Image() {
+            if(fd >= 0) close(fd);
+        }
+    };
+
     RAM() {
         memmap = std::vector<memmapEntry>();
+        pages = std::vector<Page>(PAGE_COUNT, Page{nullptr, nullptr});
+        mapped = std::vector<Page>(PAGE_COUNT, Page{nullptr, nullptr});
+        watchPages = std::vector<uint8_t>(PAGE_COUNT, 0);
+        devices = std::vector<REDevice<A, D> *>(PAGE_COUNT, nullptr);
+        versions = std::vector<uint32_t>(PAGE_COUNT, 0);
+        bank = std::vector<Page>(PAGE_COUNT, Page{nullptr, nullptr});
+        banked = std::vector<bool>(PAGE_COUNT, false);
     }
-    // ~RAM(); // TODO
+
+    // Forks from an image: writable regions are mapped MAP_PRIVATE, so a
+    // page is only copied once this RAM first writes to it. Writes never
+    // reach the image, or a file the original region was mapped from.
+    RAM(std::shared_ptr<const Image> img) : RAM() {
+        for(std::size_t i = 0; i < img->memmap.size(); i++) {
+            memmapEntry entry = img->memmap[i];
+            std::shared_ptr<void> owner = img->backing[i];
+            if(std::get<3>(entry)) owner = forkEntry(*img, entry, img->offsets[i]);
+            memmap.push_back(entry);
+            backing.push_back(owner);
+        }
+        for(std::size_t i = 0; i < img->blocks.size(); i++) {
+            memmapEntry entry = img->blocks[i];
+            blockBacking.push_back(forkEntry(*img, entry, img->blockOffsets[i]));
+            blocks.push_back(entry);
+        }
+        // Banked pages stay empty until the owner points them at its blocks
+        remap();
+
+        // Nothing written yet, so forks of this RAM can share the image
+        cached = img;
+        cachedVersions = versions;
+    }
+
+    RAM(const RAM &) = delete;
+    RAM &operator=(const RAM &) = delete;
+
 
     // For reading only
     D operator[](A addr) {
         return read(addr);
     }
 
+    // Null for I/O
     D *ptr(A addr) {
-        auto iter = std::find_if(memmap.rbegin(), memmap.rend(), [&addr](const memmapEntry &x) {
-            A addr_begin = std::get<0>(x);
-            A addr_end = addr_begin + std::get<1>(x) - 1;
-            // spdlog::debug(std::format("{:04x}:{:04x}", addr_begin, addr_end));
-            return (addr_begin <= addr) && (addr <= addr_end);
-        });
+        D *page = mapped[addr >> PAGE_BITS].rd;
+        if(page) return page + (addr & PAGE_MASK);
 
-        if(iter == memmap.rend()) {
+        const memmapEntry *region = find(addr);
+        if(!region) {
             spdlog::warn(std::format("Reading from unmapped address 0x{:x}", addr));
             return 0;
         }
+        if(std::get<5>(*region) || !std::get<2>(*region)) return 0;
 
-        memmapEntry region = *iter;
-        A offset = addr - std::get<0>(region);
-        return std::get<2>(region) + offset;
+        return std::get<2>(*region) + (addr - std::get<0>(*region));
     }
 
+    // Devices live on pages with no pointers, so they cost plain memory
+    // nothing: they are only looked for once the page table misses.
     D read(A addr) {
-        auto iter = std::find_if(memmap.rbegin(), memmap.rend(), [&addr](const memmapEntry &x) {
-            A addr_begin = std::get<0>(x);
-            A addr_end = addr_begin + std::get<1>(x) - 1;
-            // spdlog::debug(std::format("{:04x}:{:04x}", addr_begin, addr_end));
-            return (addr_begin <= addr) && (addr <= addr_end);
-        });
+        D *page = pages[addr >> PAGE_BITS].rd;
+        if(page) return page[addr & PAGE_MASK];
+        return readSlow(addr);
+    }
 
-        if(iter == memmap.rend()) {
-            spdlog::warn(std::format("Reading from unmapped address 0x{:x}", addr));
-            return 0;
+    void write(A addr, D data) {
+        // spdlog::debug("Writing {:02x} to {:04x}", data, addr);
+        D *page = pages[addr >> PAGE_BITS].wr;
+        versions[addr >> PAGE_BITS]++;
+        if(page) {
+            if(log) log->log(addr >> PAGE_BITS, page + (addr & PAGE_MASK));
+            page[addr & PAGE_MASK] = data;
+            return;
         }
+        writeSlow(addr, data);
+    }
 
-        memmapEntry region = *iter;
-        A offset = addr - std::get<0>(region);
-        return std::get<2>(region)[offset];
+    // Reads without logging, side effects or watches, for debuggers and
+    // snapshots
+    D peek(A addr) {
+        D *page = mapped[addr >> PAGE_BITS].rd;
+        if(page) return page[addr & PAGE_MASK];
+
+        const memmapEntry *region = find(addr);
+        if(!region) return 0;
+        if(std::get<5>(*region)) return std::get<5>(*region)->peek(addr);
+        if(!std::get<2>(*region)) return 0;
+        return std::get<2>(*region)[addr - std::get<0>(*region)];
     }
-    void write(A addr, D data) {
-        // spdlog::debug("Writing {:02x} to {:04x}", data, addr);
-        auto iter = std::find_if(memmap.rbegin(), memmap.rend(), [&addr](const memmapEntry &x) {
-            A addr_begin = std::get<0>(x);
-            A addr_end = addr_begin + std::get<1>(x);
-            return (addr_begin <= addr) && (addr < addr_end);
-        });
 
-        if(iter == memmap.rend()) {
-            spdlog::warn(std::format("Writing to unmapped address 0x{:x}", addr));
+    void peekPage(std::size_t pg, D *out) {
+        D *page = mapped[pg].rd;
+        if(page) {
+            memcpy(out, page, PAGE_SIZE * sizeof(D));
             return;
         }
 
-        memmapEntry region = *iter;
-        A offset = addr - std::get<0>(region);
-        bool writable = std::get<3>(region);
-        if(writable) {
-            std::get<2>(region)[offset] = data;
-        } else {
-            spdlog::warn(std::format("Writes to read-only memory ignored"));
+        for(std::size_t i = 0; i < PAGE_SIZE; i++) {
+            out[i] = peek((pg << PAGE_BITS) + i);
+        }
+    }
+
+    // Whether reads at addr go straight to memory, with no side effects
+    // other than watches
+    bool direct(A addr) {
+        return mapped[addr >> PAGE_BITS].rd != nullptr;
+    }
+
+    // Bumped on every write to a page and whenever the map changes, so
+    // readers can tell which pages changed since they last looked
+    uint32_t version(std::size_t pg) {
+        return versions[pg];
+    }
+
+    // Stays valid, and tracks version(pg), for as long as the RAM lives
+    const uint32_t *versionPtr(std::size_t pg) {
+        return &versions[pg];
+    }
+
+    // Watches take the pages they cover out of the page table, so only
+    // accesses to those pages pay for checking them. A hit is held until
+    // resume(); the CPU stops after the instruction that made it, or before
+    // an instruction hit by an EXEC watch.
+    uint32_t watch(A addr, std::size_t n, uint8_t kinds, std::function<bool(A, D)> cond = nullptr,
+        std::function<bool()> after = nullptr) {
+        watches.push_back({++lastWatch, addr, n, kinds, cond, after});
+        rewatch();
+        return lastWatch;
+    }
+
+    void unwatch(uint32_t id) {
+        std::erase_if(watches, [id](const Watch &w) { return w.id == id; });
+        rewatch();
+    }
+
+    const std::vector<Watch> &getWatches() {
+        return watches;
+    }
+
+    bool watching() {
+        return !watches.empty();
+    }
+
+    // Whether any watch covers part of the page addr is on
+    bool watched(A addr) {
+        return watchPages[addr >> PAGE_BITS];
+    }
+
+    // Whether the instruction at addr hits an EXEC watch, for the CPU to
+    // ask before running it. Free unless addr is on a watched page.
+    bool breaks(A addr) {
+        std::size_t pg = addr >> PAGE_BITS;
+        if(pages[pg].rd || !(watchPages[pg] & WATCH_EXEC)) return false;
+        return hitSlow(addr, WATCH_EXEC, peek(addr));
+    }
+
+    // The CPU only asks between instructions, which is when a hit's after
+    // check runs
+    bool stopped() {
+        if(pending && settle) {
+            pending = settle();
+            settle = nullptr;
+        }
+        return pending;
+    }
+
+    // The first hit since the last resume()
+    const Hit &lastHit() {
+        return hit;
+    }
+
+    void resume() {
+        pending = false;
+        settle = nullptr;
+    }
+
+    // While set, the old value of every write is logged there, for rewind
+    void setLog(REWriteLog<A, D> *l) {
+        log = l;
+    }
+
+    // For devices that switch banks: logs n bytes of their own state before
+    // they change it, so rewinding over a switch puts both back together
+    void logHost(D *p, std::size_t n) {
+        if(!log) return;
+        for(std::size_t i = 0; i < n; i++) log->logHost(p + i);
+    }
+
+    // Puts back what one log entry recorded. Rewind calls this with the log
+    // unset, going from the newest entry back.
+    void undo(const typename REWriteLog<A, D>::Entry &e) {
+        switch(e.kind) {
+        case REWriteLog<A, D>::MEMORY:
+            *e.ptr = e.old;
+            versions[e.pg]++;
+            break;
+        case REWriteLog<A, D>::HOST:
+            *e.ptr = e.old;
+            break;
+        case REWriteLog<A, D>::PAGE_RD:
+            setPage(e.pg, e.ptr, bank[e.pg].wr);
+            break;
+        case REWriteLog<A, D>::PAGE_WR:
+            setPage(e.pg, bank[e.pg].rd, e.ptr);
+            break;
         }
     }
 
     // TODO: Check for past end of addressable memory
     void mapMem(const char *id, A addr, std::size_t n, bool writable = false) {
         D *buf = (D *)calloc(n, sizeof(D));
-        memmapEntry entry = memmapEntry(addr, n, buf, writable, id);
-        memmap.push_back(entry);
+        map(memmapEntry(addr, n, buf, writable, id, nullptr), std::shared_ptr<void>(buf, free));
     }
 
+    // The caller keeps buf alive for as long as it is mapped
     void mapBuf(const char *id, A addr, std::size_t n, D *buf, bool writable = false) {
-        memmapEntry entry = memmapEntry(addr, n, buf, writable, id);
-        memmap.push_back(entry);
+        map(memmapEntry(addr, n, buf, writable, id, nullptr), nullptr);
     }
 
-    // Parameter n is ignored on read-only mapping (uses size of file).
-    void mapFil(const char *id, A addr, std::size_t n, const char *filepath, bool writable = false) {
-        D *buf;
+    // Every access in the range goes to dev, which the caller keeps alive
+    void mapDev(const char *id, A addr, std::size_t n, REDevice<A, D> *dev) {
+        map(memmapEntry(addr, n, nullptr, false, id, dev), nullptr);
+    }
 
+    // Parameter n is ignored on read-only mapping (uses size of file).
+    // Read-only files come from the ROM cache, so mapping one many times
+    // shares a single copy. False, with nothing mapped, if the file could
+    // not be.
+    bool mapFil(const char *id, A addr, std::size_t n, const char *filepath, bool writable = false) {
         if(writable) {
-            int file = open(filepath, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
-            posix_fallocate(file, 0, n * sizeof(D));
-            buf = (D *)mmap(NULL, n * sizeof(D), PROT_WRITE, MAP_SHARED, file, 0);
-        } else {
-            // This copies file contents, which means it cannot write back to file
-            std::ifstream file(filepath, std::ios::binary | std::ios::ate);
-            if(!file.is_open()) {
+            int file = open(filepath, O_CREAT | O_RDWR | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+            if(file < 0) {
                 spdlog::error(std::format("Failed to open \"{}\"", filepath));
-                return;
-            } else {
-                n = file.tellg();
-                buf = (D *)calloc(n, sizeof(D));
-                file.seekg(0, std::ios::beg);
-                file.read((char *)buf, n);
+                return false;
             }
+            posix_fallocate(file, 0, n * sizeof(D));
+            std::size_t bytes = n * sizeof(D);
+            D *buf = (D *)mmap(NULL, bytes, PROT_WRITE, MAP_SHARED, file, 0);
+            close(file);
+            if(buf == MAP_FAILED) {
+                spdlog::error(std::format("Failed to map \"{}\"", filepath));
+                return false;
+            }
+            map(memmapEntry(addr, n, buf, writable, id, nullptr), std::shared_ptr<void>(buf, [bytes](void *p) { munmap(p, bytes); }));
+        } else {
+            std::shared_ptr<const RERom> rom = RERomCache::get(filepath);
+            if(!rom) return false;
+            map(memmapEntry(addr, rom->size / sizeof(D), (D *)rom->data, writable, id, nullptr), std::const_pointer_cast<RERom>(rom));
         }
+        return true;
+    }
 
-        memmapEntry entry = memmapEntry(addr, n, buf, writable, id);
-        memmap.push_back(entry);
+    // Leaves the pages in the range to setPage(), for bank switching. Pages
+    // it has not set yet read as unmapped.
+    void mapBank(const char *id, A addr, std::size_t n) {
+        map(memmapEntry(addr, n, nullptr, false, id, nullptr), nullptr);
+    }
+
+    // Memory with no address of its own, for setPage() to swap in. It is
+    // freed with the RAM, and saved, loaded and forked like a writable
+    // region.
+    D *alloc(const char *id, std::size_t n) {
+        D *buf = (D *)calloc(n, sizeof(D));
+        blocks.push_back(memmapEntry(0, n, buf, true, id, nullptr));
+        blockBacking.push_back(std::shared_ptr<void>(buf, free));
+        return buf;
+    }
+
+    // Looks up a block by ID, mainly to find a fork's copies
+    D *block(const char *id) {
+        for(auto &b : blocks) {
+            if(!strncmp(id, std::get<4>(b), 16)) return std::get<2>(b);
+        }
+        spdlog::warn(std::format("Could not find block with ID: {}", id));
+        return nullptr;
+    }
+
+    // Points one page of a banked range at rd and wr, or write-protects it
+    // with a null wr. Only the page table changes, so switching a bank
+    // costs a couple of pointers per page and the memmap is left alone.
+    void setPage(std::size_t pg, D *rd, D *wr) {
+        if(bank[pg].rd == rd && bank[pg].wr == wr) return;
+        if(log) {
+            log->logPage(pg, REWriteLog<A, D>::PAGE_RD, bank[pg].rd);
+            log->logPage(pg, REWriteLog<A, D>::PAGE_WR, bank[pg].wr);
+        }
+        bank[pg] = {rd, wr};
+        if(!banked[pg]) return;
+
+        mapped[pg] = bank[pg];
+        pages[pg] = unwatched(pg);
+        versions[pg]++;
     }
 
     void unmap(const char *id) {
@@ -163,31 +416,373 @@ public:
             const char *idx = std::get<4>(*iter);
 
             spdlog::debug("E: {:04x} {:04x}: {} ({})", addr, s, wr ? "RW" : "RO", idx);
-        memmap.erase(--(iter.base()));
+        std::size_t i = std::distance(memmap.begin(), --(iter.base()));
+        memmap.erase(memmap.begin() + i);
+        backing.erase(backing.begin() + i);
+        remap();
     }
 
-    void printMap() {
-        for(auto it = memmap.begin(); it != memmap.end(); it++) {
-            A addr = std::get<0>(*it);
-            std::size_t s = std::get<1>(*it);
-            bool wr = std::get<3>(*it);
-            const char *id = std::get<4>(*it);
+    // Captures the current contents for forking. The copy is reused until
+    // the next write or remap, so forking many children from one state
+    // costs one copy of the writable regions in total.
+    std::shared_ptr<const Image> image() {
+        if(cached && cachedVersions == versions) return cached;
+
+        auto img = std::make_shared<Image>();
+        img->memmap = memmap;
+        img->backing = backing;
+
+        img->blocks = blocks;
+
+        std::size_t host = sysconf(_SC_PAGESIZE);
+        off_t size = 0;
+        for(auto &e : memmap) {
+            off_t offset = -1;
+            if(std::get<3>(e)) {
+                offset = size;
+                size += (std::get<1>(e) * sizeof(D) + host - 1) / host * host;
+            }
+            img->offsets.push_back(offset);
+        }
+        for(auto &e : blocks) {
+            img->blockOffsets.push_back(size);
+            size += (std::get<1>(e) * sizeof(D) + host - 1) / host * host;
+        }
+
+        img->fd = memfd_create("retroemu-image", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if(img->fd < 0 || ftruncate(img->fd, size) < 0) {
+            spdlog::error("Failed to create memory image");
+            return nullptr;
+        }
+
+        for(std::size_t i = 0; i < memmap.size(); i++) {
+            if(img->offsets[i] < 0) continue;
+            img->backing[i] = nullptr; // The memfd has its own copy
+            if(!imageEntry(*img, memmap[i], img->offsets[i])) return nullptr;
+        }
+        for(std::size_t i = 0; i < blocks.size(); i++) {
+            if(!imageEntry(*img, blocks[i], img->blockOffsets[i])) return nullptr;
+        }
+
+        // Private mappings are still allowed once sealed; shared writes are not
+        fcntl(img->fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+
+        cached = img;
+        cachedVersions = versions;
+        return img;
+    }
 
-            // spdlog::debug("{:04x} {:04x}: {} ({})", addr, s, wr ? "RW" : "RO", id);
-            memmapEntry entry = *it;
-            // spdlog::debug(std::format("{}", entry));
+    // Writable regions and blocks are stored whole, read-only ones by
+    // content hash, devices and banked ranges not at all.
+    // Loading requires the same mappings, in the same order; with apply
+    // false it only checks that, so a state can be validated before any
+    // of it is applied.
+    void save(REStateWriter &w) {
+        w.put<uint32_t>(memmap.size());
+        for(auto &e : memmap) {
+            w.str(std::get<4>(e));
+            w.put<uint64_t>(std::get<0>(e));
+            w.put<uint64_t>(std::get<1>(e));
+            w.put<uint8_t>(std::get<3>(e));
+            if(std::get<5>(e) || !std::get<2>(e)) {
+                continue; // Devices and bank owners save their own state
+            } else if(std::get<3>(e)) {
+                w.bytes(std::get<2>(e), std::get<1>(e) * sizeof(D));
+            } else {
+                w.put<uint64_t>(REStateHash(std::get<2>(e), std::get<1>(e) * sizeof(D)));
+            }
+        }
+
+        w.put<uint32_t>(blocks.size());
+        for(auto &e : blocks) {
+            w.str(std::get<4>(e));
+            w.bytes(std::get<2>(e), std::get<1>(e) * sizeof(D));
+        }
+    }
+
+    bool load(REStateReader &r, bool apply = true) {
+        uint32_t n = 0;
+        if(!r.get(n) || n != memmap.size()) {
+            spdlog::error("Saved memory map does not match");
+            return false;
+        }
+
+        for(auto &e : memmap) {
+            uint64_t addr = 0, size = 0, hash = 0;
+            uint8_t writable = 0;
+            if(!r.expectStr(std::get<4>(e)) || !r.get(addr) || !r.get(size) || !r.get(writable) ||
+               addr != std::get<0>(e) || size != std::get<1>(e) || writable != std::get<3>(e)) {
+                spdlog::error(std::format("Saved mapping does not match \"{}\"", std::get<4>(e)));
+                return false;
+            }
+
+            if(std::get<5>(e) || !std::get<2>(e)) {
+                continue;
+            } else if(writable) {
+                const uint8_t *p = r.view(size * sizeof(D));
+                if(!p) return false;
+                if(apply) memcpy(std::get<2>(e), p, size * sizeof(D));
+            } else if(!r.get(hash) || hash != REStateHash(std::get<2>(e), size * sizeof(D))) {
+                spdlog::error(std::format("ROM contents of \"{}\" do not match saved state", std::get<4>(e)));
+                return false;
+            }
+        }
+
+        if(!r.get(n) || n != blocks.size()) {
+            spdlog::error("Saved memory blocks do not match");
+            return false;
+        }
+        for(auto &e : blocks) {
+            if(!r.expectStr(std::get<4>(e))) {
+                spdlog::error(std::format("Saved block does not match \"{}\"", std::get<4>(e)));
+                return false;
+            }
+            const uint8_t *p = r.view(std::get<1>(e) * sizeof(D));
+            if(!p) return false;
+            if(apply) memcpy(std::get<2>(e), p, std::get<1>(e) * sizeof(D));
+        }
+
+        // Everything may have changed under readers tracking page versions
+        if(apply) remap();
+        return true;
+    }
+
+    void printMap() {
+        for(auto &e : memmap) {
+            spdlog::debug("{:04x} {:04x}: {} ({})", std::get<0>(e), std::get<1>(e), std::get<3>(e) ? "RW" : "RO", std::get<4>(e));
         }
     }
 
 private:
-    typedef std::tuple<A, std::size_t, D *, bool, const char *> memmapEntry;
     std::vector<memmapEntry> memmap;
-};
 
-#endif
+    // What frees each mapping's buffer when it goes, parallel to memmap;
+    // null for buffers the caller owns
+    std::vector<std::shared_ptr<void>> backing;
+
+    REWriteLog<A, D> *log = nullptr;
+
+    std::shared_ptr<const Image> cached;
+    std::vector<uint32_t> cachedVersions;
+
+    // Pointers to the first byte of each page. A null entry means the page
+    // is unmapped, read-only (wr only), or only partially covered by the
+    // topmost mapping; those fall back to the memmap scan.
+    struct Page {
+        D *rd;
+        D *wr;
+    };
+    std::vector<Page> pages;
+    std::vector<uint32_t> versions;
+
+    // The page table as the memory map has it, and the kinds of watch on
+    // each page. pages is the same less whatever is being watched.
+    std::vector<Page> mapped;
+    std::vector<uint8_t> watchPages;
+    std::vector<Watch> watches;
+    uint32_t lastWatch = 0;
+    Hit hit = {};
+    bool pending = false;
+    // The after check of the pending hit, until stopped() has run it
+    std::function<bool()> settle;
+
+    // Device covering each whole page, if any, to skip the memmap scan
+    std::vector<REDevice<A, D> *> devices;
+
+    // What setPage() last asked for each page, and whether a banked range
+    // is currently on top there to take it
+    std::vector<Page> bank;
+    std::vector<bool> banked;
+
+    // Unaddressed memory from alloc(), and what frees it
+    std::vector<memmapEntry> blocks;
+    std::vector<std::shared_ptr<void>> blockBacking;
+
+    void map(const memmapEntry &entry, std::shared_ptr<void> owner) {
+        memmap.push_back(entry);
+        backing.push_back(owner);
+        remap();
+    }
+
+    static bool imageEntry(const Image &img, const memmapEntry &e, off_t offset) {
+        std::size_t bytes = std::get<1>(e) * sizeof(D);
+        if(pwrite(img.fd, std::get<2>(e), bytes, offset) != (ssize_t)bytes) {
+            spdlog::error(std::format("Failed to write image of \"{}\"", std::get<4>(e)));
+            return false;
+        }
+        return true;
+    }
+
+    // Maps an entry's copy in the image privately, pointing it there
+    static std::shared_ptr<void> forkEntry(const Image &img, memmapEntry &entry, off_t offset) {
+        std::size_t bytes = std::get<1>(entry) * sizeof(D);
+        if(!bytes) return nullptr;
+
+        std::shared_ptr<void> owner;
+        void *buf = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, img.fd, offset);
+        if(buf == MAP_FAILED) {
+            spdlog::error(std::format("Failed to map image of \"{}\", copying it", std::get<4>(entry)));
+            buf = calloc(std::get<1>(entry), sizeof(D));
+            owner = std::shared_ptr<void>(buf, free);
+            if(pread(img.fd, buf, bytes, offset) != (ssize_t)bytes)
+                spdlog::error(std::format("Failed to read image of \"{}\"", std::get<4>(entry)));
+        } else {
+            owner = std::shared_ptr<void>(buf, [bytes](void *p) { munmap(p, bytes); });
+        }
+        std::get<2>(entry) = (D *)buf;
+        return owner;
+    }
 
+    Page unwatched(std::size_t pg) {
+        Page page = mapped[pg];
+        if(watchPages[pg] & (WATCH_READ | WATCH_EXEC)) page.rd = nullptr;
+        if(watchPages[pg] & WATCH_WRITE) page.wr = nullptr;
+        return page;
+    }
+
+    // Pages whose watches changed get new versions, so anything decoded
+    // from them (trace blocks) is looked at again
+    void rewatch() {
+        std::vector<uint8_t> before = watchPages;
+        std::fill(watchPages.begin(), watchPages.end(), 0);
+        for(auto &w : watches) {
+            if(!w.n) continue;
+            std::size_t last = ((std::size_t)w.addr + w.n - 1) >> PAGE_BITS;
+            for(std::size_t pg = w.addr >> PAGE_BITS; pg <= last && pg < PAGE_COUNT; pg++) watchPages[pg] |= w.kinds;
+        }
+        for(std::size_t pg = 0; pg < PAGE_COUNT; pg++) {
+            pages[pg] = unwatched(pg);
+            if(watchPages[pg] != before[pg]) versions[pg]++;
+        }
+    }
+
+    bool hitSlow(A addr, uint8_t kind, D data) {
+        for(auto &w : watches) {
+            if(!(w.kinds & kind) || addr < w.addr || (std::size_t)addr - w.addr >= w.n) continue;
+            if(w.cond && !w.cond(addr, data)) continue;
+            if(!pending) {
+                hit = {w.id, addr, kind, data};
+                settle = w.after;
+            }
+            pending = true;
+            return true;
+        }
+        return false;
+    }
+
+    D readSlow(A addr) {
+        std::size_t pg = addr >> PAGE_BITS;
+        if(!watchPages[pg]) return readMapped(addr);
+
+        D *page = mapped[pg].rd;
+        D data = page ? page[addr & PAGE_MASK] : readMapped(addr);
+        if(watchPages[pg] & WATCH_READ) hitSlow(addr, WATCH_READ, data);
+        return data;
+    }
 
+    void writeSlow(A addr, D data) {
+        std::size_t pg = addr >> PAGE_BITS;
+        if(watchPages[pg]) {
+            if(watchPages[pg] & WATCH_WRITE) hitSlow(addr, WATCH_WRITE, data);
+            D *page = mapped[pg].wr;
+            if(page) {
+                if(log) log->log(pg, page + (addr & PAGE_MASK));
+                page[addr & PAGE_MASK] = data;
+                return;
+            }
+        }
+        writeMapped(addr, data);
+    }
 
+    D readMapped(A addr) {
+        REDevice<A, D> *dev = devices[addr >> PAGE_BITS];
+        if(dev) return dev->read(addr);
 
+        const memmapEntry *region = find(addr);
+        if(!region) {
+            spdlog::warn(std::format("Reading from unmapped address 0x{:x}", addr));
+            return 0;
+        }
+        if(std::get<5>(*region)) return std::get<5>(*region)->read(addr);
+        if(!std::get<2>(*region)) return 0;
 
+        return std::get<2>(*region)[addr - std::get<0>(*region)];
+    }
 
+    void writeMapped(A addr, D data) {
+        REDevice<A, D> *dev = devices[addr >> PAGE_BITS];
+        if(dev) {
+            dev->write(addr, data);
+            return;
+        }
+
+        const memmapEntry *region = find(addr);
+        if(!region) {
+            spdlog::warn(std::format("Writing to unmapped address 0x{:x}", addr));
+            return;
+        }
+
+        if(std::get<5>(*region)) {
+            std::get<5>(*region)->write(addr, data);
+        } else if(!std::get<2>(*region)) {
+            // Write-protected bank, which simply ignores them
+        } else if(std::get<3>(*region)) {
+            D *p = std::get<2>(*region) + (addr - std::get<0>(*region));
+            if(log) log->log(addr >> PAGE_BITS, p);
+            *p = data;
+        } else {
+            spdlog::warn(std::format("Writes to read-only memory ignored"));
+        }
+    }
+
+    // Last mapping wins, same as the page table
+    const memmapEntry *find(A addr) const {
+        for(auto it = memmap.rbegin(); it != memmap.rend(); it++) {
+            std::size_t begin = std::get<0>(*it);
+            if(begin <= addr && (std::size_t)addr - begin < std::get<1>(*it))
+                return &(*it);
+        }
+        return nullptr;
+    }
+
+    void remap() {
+        for(std::size_t pg = 0; pg < PAGE_COUNT; pg++) {
+            std::size_t base = pg << PAGE_BITS;
+            Page page = {nullptr, nullptr};
+            REDevice<A, D> *dev = nullptr;
+            bool bnk = false;
+
+            // Only the topmost mapping touching the page matters; if it does
+            // not cover the whole page, leave it to the slow path.
+            for(auto it = memmap.rbegin(); it != memmap.rend(); it++) {
+                std::size_t begin = std::get<0>(*it);
+                std::size_t end = begin + std::get<1>(*it);
+                if(end <= base || begin >= base + PAGE_SIZE)
+                    continue;
+
+                if(begin <= base && base + PAGE_SIZE <= end) {
+                    if(std::get<5>(*it)) {
+                        dev = std::get<5>(*it);
+                    } else if(!std::get<2>(*it)) {
+                        page = bank[pg];
+                        bnk = true;
+                    } else {
+                        D *p = std::get<2>(*it) + (base - begin);
+                        page = {p, std::get<3>(*it) ? p : nullptr};
+                    }
+                }
+                break;
+            }
+
+            mapped[pg] = page;
+            pages[pg] = unwatched(pg);
+            devices[pg] = dev;
+            banked[pg] = bnk;
+            versions[pg]++;
+        }
+
+        if(log) log->clear();
+    }
+};
+
+#endif
@@ -10,7 +10,9 @@ Register::Register(uint8_t width, uint32_t resetVal, Display display,
       maskOn(maskOn),
       maskOff(maskOff),
       disp(display),
-      help(help) {
+      help(help),
+      field(&value),
+      bytes(sizeof(value)) {
   reset();
 }
 
@@ -20,10 +22,26 @@ void Register::set(uint32_t val) {
   val &= mask;
   val |= maskOn;
   val &= ~maskOff;
-  value = val;
+  switch(bytes) {
+    case 1: *(uint8_t *)field = val; break;
+    case 2: *(uint16_t *)field = val; break;
+    default: *(uint32_t *)field = val; break;
+  }
 }
 
-uint32_t Register::get() { return value; }
+uint32_t Register::get() {
+  uint32_t val;
+  switch(bytes) {
+    case 1: val = *(uint8_t *)field; break;
+    case 2: val = *(uint16_t *)field; break;
+    default: val = *(uint32_t *)field; break;
+  }
+  // Fields narrower than the register (e.g. SP) only hold the variable bits
+  val &= mask;
+  val |= maskOn;
+  val &= ~maskOff;
+  return val;
+}
 
 void Register::operator=(uint32_t val) { set(val); }
 
@@ -51,10 +69,6 @@ uint32_t Register::operator--(int) {
   return val;
 }
 
-uint32_t *Register::ptr() {
-  return &value;
-}
-
 Registers::Registers() { r = std::map<std::string, Register *>(); }
 
 Register *Registers::operator[](std::string name) { return r[name]; }
@@ -20,7 +20,24 @@ public:
         uint32_t maskOff = 0,
         const char *help = nullptr
     );
-    
+
+    // View over a register stored elsewhere, e.g. a CPU's register struct
+    template <typename T>
+    Register(
+        T *field,
+        uint8_t width,
+        uint32_t resetVal = 0,
+        Display display = HEX,
+        uint32_t maskOn = 0,
+        uint32_t maskOff = 0,
+        const char *help = nullptr
+    ) : Register(width, resetVal, display, maskOn, maskOff, help) {
+        static_assert(sizeof(T) <= sizeof(uint32_t), "register field too wide");
+        this->field = field;
+        this->bytes = sizeof(T);
+        reset();
+    }
+
     void reset();
     void set(uint32_t);
     uint32_t get();
@@ -32,10 +49,10 @@ public:
     uint32_t operator++(int);
     uint32_t operator--(int);
 
-    uint32_t *ptr();
-
 private:
     uint32_t value;
+    void *field;
+    uint8_t bytes;
     uint32_t mask;
     uint32_t resetVal = 0;
     uint32_t maskOn = 0;
@@ -0,0 +1,268 @@
+#ifndef __REWIND_HPP
+#define __REWIND_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include <common/state.hpp>
+
+template <typename A, typename D>
+class RAM;
+
+// Ring of the values RAM writes overwrote. RAM only knows about this half
+// of the recorder, since it does not know what CPU state looks like.
+//
+// Entries point at the host storage written rather than the guest address,
+// so they still undo the right byte after a bank switch has moved it out
+// from under that address. Bank switches are logged as entries of their
+// own, along with the state of whatever switched them, so going back over
+// one switches back.
+template <typename A, typename D>
+class REWriteLog {
+public:
+    enum Kind : uint8_t {
+        MEMORY,  // A byte of a region or block, which keyframes also have
+        HOST,    // A byte of some device's state
+        PAGE_RD, // ptr is what page pg last read from
+        PAGE_WR  // ptr is what page pg last wrote to
+    };
+
+    struct Entry {
+        D *ptr;
+        uint32_t pg;
+        Kind kind;
+        D old;
+    };
+
+    // Before *p is written through page pg
+    void log(std::size_t pg, D *p) {
+        ring[head++ & mask] = {p, (uint32_t)pg, MEMORY, *p};
+    }
+
+    void logHost(D *p) {
+        ring[head++ & mask] = {p, 0, HOST, *p};
+    }
+
+    void logPage(std::size_t pg, Kind kind, D *old) {
+        ring[head++ & mask] = {old, (uint32_t)pg, kind, 0};
+    }
+
+    // The memory map changed under us; nothing before now can be undone
+    void clear() {
+        cleared = true;
+    }
+
+protected:
+    std::vector<Entry> ring;
+    uint64_t mask = 0;
+    uint64_t head = 0;
+    bool cleared = false;
+};
+
+// Records enough history to run a CPU backwards, cheaply enough to leave
+// on. RAM logs the old value of every write. The CPU hands over its state
+// S in a mark every INTERVAL instructions, and whenever it starts running,
+// since anything between runs (debugger edits) cannot be replayed.
+//
+// Going back restores the latest mark at or before the target and undoes
+// the writes made since; the CPU then replays the remaining few
+// instructions, which lands it exactly on the target. Every so often a
+// keyframe of all writable memory is kept as well, so long jumps restore
+// the nearest keyframe instead of undoing every write on the way.
+//
+// All of this stays within the budget given: three quarters to the rings,
+// a quarter to keyframes. The oldest history is dropped first.
+template <typename S, typename A, typename D>
+class RERewind : public REWriteLog<A, D> {
+public:
+    static constexpr uint32_t INTERVAL = 64;
+    static constexpr uint64_t MIN_KEYFRAME_INTERVAL = 1 << 20;
+
+    RERewind(RAM<A, D> *mem, std::size_t budget) : mem(mem), budget(budget) {
+        // A mark per INTERVAL instructions is small next to their writes
+        std::size_t rings = budget * 3 / 4;
+        std::size_t nw = pow2(rings * 4 / 5 / sizeof(typename REWriteLog<A, D>::Entry));
+        std::size_t nm = pow2(rings / 5 / sizeof(Mark));
+
+        this->ring = std::vector<typename REWriteLog<A, D>::Entry>(nw);
+        this->mask = nw - 1;
+        marks = std::vector<Mark>(nm);
+        keyInterval = MIN_KEYFRAME_INTERVAL;
+        maxKeyframes = 1;
+
+        mem->setLog(this);
+    }
+
+    ~RERewind() {
+        mem->setLog(nullptr);
+    }
+
+    void mark(const S &s, uint64_t cycles) {
+        if(this->cleared) restart();
+
+        // Nothing ran since the last mark: it is stale, not history
+        if(count > base && marks[(count - 1) & (marks.size() - 1)].pos == pos) count--;
+        marks[count++ & (marks.size() - 1)] = {pos, this->head, cycles, s};
+
+        if(pos >= nextKey) keyframe();
+    }
+
+    // Instructions run since the last mark
+    void advance(uint64_t n) {
+        pos += n;
+    }
+
+    // Goes back to the latest mark at or before n instructions ago and
+    // returns how many instructions the CPU has to run to get the rest of
+    // the way. History only goes so far, so that may be fewer than n.
+    uint64_t back(uint64_t n, S &s, uint64_t &cycles) {
+        if(!depth()) return 0;
+
+        uint64_t target = pos - std::min(n, pos - marks[first & (marks.size() - 1)].pos);
+
+        // Latest mark at or before the target
+        uint64_t lo = first, hi = count;
+        while(hi - lo > 1) {
+            uint64_t mid = lo + (hi - lo) / 2;
+            if(marks[mid & (marks.size() - 1)].pos <= target) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        Mark &m = marks[lo & (marks.size() - 1)];
+
+        mem->setLog(nullptr);
+
+        // The nearest keyframe after the mark saves undoing everything
+        // written since. It only holds memory, so bank switches and device
+        // state on the way still have to be taken back, before it is
+        // loaded into whatever the banks were then.
+        for(auto &k : keyframes) {
+            if(k.pos < m.pos) continue;
+            if(k.head < this->head) {
+                while(this->head > k.head) {
+                    auto &e = this->ring[--this->head & this->mask];
+                    if(e.kind != REWriteLog<A, D>::MEMORY) mem->undo(e);
+                }
+                REStateReader r(k.mem);
+                mem->load(r);
+            }
+            break;
+        }
+
+        while(this->head > m.head) {
+            mem->undo(this->ring[--this->head & this->mask]);
+        }
+
+        mem->setLog(this);
+
+        s = m.s;
+        cycles = m.cycles;
+        pos = m.pos;
+        count = lo + 1;
+
+        // Anything later than where we are now has been undone
+        while(!keyframes.empty() && keyframes.back().pos > pos) keyframes.pop_back();
+        nextKey = keyframes.empty() ? pos : keyframes.back().pos + keyInterval;
+
+        return target - pos;
+    }
+
+    // Number of instructions that can currently be undone
+    uint64_t depth() {
+        if(this->cleared || count == base) return 0;
+
+        topMarks = std::max(topMarks, count);
+        topHead = std::max(topHead, this->head);
+
+        // Marks and the writes after them are overwritten oldest first, so
+        // the usable ones are a suffix, found by bisection
+        uint64_t lo = std::max(base, topMarks - std::min<uint64_t>(topMarks, marks.size()));
+        uint64_t hi = count;
+        uint64_t floor = topHead - std::min<uint64_t>(topHead, this->ring.size());
+        while(lo < hi) {
+            uint64_t mid = lo + (hi - lo) / 2;
+            if(marks[mid & (marks.size() - 1)].head >= floor) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+
+        first = lo;
+        return first < count ? pos - marks[first & (marks.size() - 1)].pos : 0;
+    }
+
+private:
+    struct Mark {
+        uint64_t pos;
+        uint64_t head;
+        uint64_t cycles;
+        S s;
+    };
+
+    struct Keyframe {
+        uint64_t pos;
+        uint64_t head;
+        std::vector<uint8_t> mem;
+    };
+
+    RAM<A, D> *mem;
+    std::size_t budget;
+
+    std::vector<Mark> marks;
+    uint64_t count = 0; // Marks made
+    uint64_t first = 0; // Oldest usable mark, as of the last depth()
+    uint64_t base = 0;  // First mark since the memory map last changed
+    uint64_t pos = 0;   // Instructions run
+
+    // Furthest either ring has got; going back moves away from there, but
+    // the slots overwritten on the way stay lost
+    uint64_t topMarks = 0;
+    uint64_t topHead = 0;
+
+    std::deque<Keyframe> keyframes;
+    std::size_t maxKeyframes;
+    uint64_t keyInterval;
+    uint64_t nextKey = 0;
+
+    static std::size_t pow2(std::size_t n) {
+        std::size_t p = 1;
+        while(p * 2 <= n) p *= 2;
+        return p;
+    }
+
+    // After the memory map changes, the first keyframe waits a full
+    // interval rather than copying all of memory straight away
+    void restart() {
+        this->cleared = false;
+        base = count;
+        keyframes.clear();
+        nextKey = pos + keyInterval;
+    }
+
+    void keyframe() {
+        Keyframe k = {pos, this->head, {}};
+        if(keyframes.size() >= maxKeyframes) {
+            k.mem.swap(keyframes.front().mem);
+            k.mem.clear();
+            keyframes.pop_front();
+        }
+        REStateWriter w(k.mem);
+        mem->save(w);
+
+        // Keyframes are as big as writable memory, which only shows once
+        // one has been taken. Spread them over what the rings can hold.
+        std::size_t size = k.mem.size() + sizeof(Keyframe);
+        maxKeyframes = std::max<std::size_t>(1, budget / 4 / size);
+        keyInterval = std::max<uint64_t>(MIN_KEYFRAME_INTERVAL, this->ring.size() / maxKeyframes);
+
+        keyframes.push_back(std::move(k));
+        nextKey = pos + keyInterval;
+    }
+};
+
+#endif
@@ -0,0 +1,52 @@
+#include <format>
+#include <map>
+#include <mutex>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <spdlog/spdlog.h>
+
+#include <common/rom.hpp>
+
+RERom::~RERom() {
+    munmap((void *)data, size);
+}
+
+std::shared_ptr<const RERom> RERomCache::get(const char *path) {
+    static std::mutex m;
+    static std::map<std::pair<dev_t, ino_t>, std::weak_ptr<const RERom>> roms;
+
+    struct stat st;
+    if(stat(path, &st) < 0) {
+        spdlog::error(std::format("Failed to open \"{}\"", path));
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> l(m);
+    auto key = std::make_pair(st.st_dev, st.st_ino);
+
+    auto it = roms.find(key);
+    if(it != roms.end()) {
+        if(auto rom = it->second.lock()) return rom;
+        roms.erase(it);
+    }
+
+    int file = open(path, O_RDONLY | O_CLOEXEC);
+    if(file < 0 || fstat(file, &st) < 0 || st.st_size == 0) {
+        spdlog::error(std::format("Failed to open \"{}\"", path));
+        if(file >= 0) close(file);
+        return nullptr;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if(data == MAP_FAILED) {
+        spdlog::error(std::format("Failed to map \"{}\"", path));
+        return nullptr;
+    }
+
+    auto rom = std::make_shared<const RERom>((const uint8_t *)data, st.st_size);
+    roms[key] = rom;
+    return rom;
+}
@@ -0,0 +1,27 @@
+#ifndef __ROM_HPP
+#define __ROM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// A ROM file mapped read-only. Contents are shared by every mapping of it,
+// and through the page cache with anything else that maps the same file.
+struct RERom {
+    const uint8_t *data;
+    std::size_t size;
+
+    RERom(const uint8_t *data, std::size_t size) : data(data), size(size) {}
+    ~RERom();
+};
+
+// Process-wide cache of mapped ROMs, keyed by file identity rather than
+// path. A file is mapped on first use and unmapped when its last user lets
+// go; mapping it again meanwhile only costs a stat.
+class RERomCache {
+public:
+    // Null if the file cannot be opened or mapped
+    static std::shared_ptr<const RERom> get(const char *path);
+};
+
+#endif
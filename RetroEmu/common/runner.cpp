@@ -0,0 +1,220 @@
+#include <chrono>
+
+#include <common/runner.hpp>
+
+RERunner::RERunner(REMachine *mach)
+    : mach(mach),
+      clk_khz(mach->getClockKHz()),
+      quit(false),
+      running(false),
+      throttled(true),
+      waiting(0),
+      khz(0) {
+    std::map<std::string, Register *> *all = mach->getRegs()->getAll();
+    for(auto it = all->begin(); it != all->end(); it++) {
+        regs.push_back(it->second);
+    }
+
+    publish();
+    thread = std::thread(&RERunner::loop, this);
+}
+
+RERunner::~RERunner() {
+    {
+        std::lock_guard<std::recursive_mutex> l(m);
+        quit = true;
+    }
+    cv.notify_all();
+    thread.join();
+}
+
+void RERunner::run() {
+    {
+        std::lock_guard<std::recursive_mutex> l(m);
+        mach->getMem()->resume();
+        running = true;
+    }
+    cv.notify_all();
+}
+
+void RERunner::pause() {
+    std::lock_guard<std::recursive_mutex> l(m);
+    running = false;
+    khz = 0;
+}
+
+void RERunner::step() {
+    if(running) return;
+
+    post({RECommand::STEP, 0, 0});
+}
+
+void RERunner::stepBack(uint32_t n) {
+    if(running) return;
+
+    post({RECommand::STEP_BACK, 0, n});
+}
+
+void RERunner::reverseContinue() {
+    if(running) return;
+
+    post({RECommand::REVERSE_CONTINUE, 0, 0});
+}
+
+bool RERunner::isRunning() {
+    return running;
+}
+
+void RERunner::setThrottle(bool t) {
+    throttled = t;
+}
+
+bool RERunner::isThrottled() {
+    return throttled;
+}
+
+std::unique_lock<std::recursive_mutex> RERunner::lock() {
+    // Tells the emulation thread to let go between slices, so an
+    // unthrottled run cannot starve the caller
+    waiting++;
+    std::unique_lock<std::recursive_mutex> l(m);
+    waiting--;
+    return l;
+}
+
+double RERunner::getKHz() {
+    return khz;
+}
+
+const RERunner::Snapshot &RERunner::snapshot() {
+    return snapshots.acquire();
+}
+
+bool RERunner::post(RECommand cmd) {
+    if(!commands.push(cmd)) return false;
+
+    // A running thread picks it up at the next slice; a paused one has to
+    // be woken, and taking the lock first means the wakeup cannot be lost
+    if(!running) {
+        { std::lock_guard<std::recursive_mutex> l(m); }
+        cv.notify_all();
+    }
+    return true;
+}
+
+void RERunner::apply() {
+    RECommand cmd;
+    while(commands.pop(cmd)) {
+        switch(cmd.type) {
+        case RECommand::WRITE_MEM:
+            mach->getMem()->write(cmd.target, cmd.value);
+            break;
+        case RECommand::SET_REG:
+            if(cmd.target < regs.size()) regs[cmd.target]->set(cmd.value);
+            break;
+        case RECommand::STEP:
+            mach->getMem()->resume();
+            mach->step();
+            break;
+        case RECommand::STEP_BACK:
+            mach->stepBack(cmd.value);
+            // Replays pass through watches too; those are not new hits
+            mach->getMem()->resume();
+            break;
+        case RECommand::REVERSE_CONTINUE:
+            mach->reverseContinue();
+            break;
+        case RECommand::RESET:
+            mach->reset();
+            break;
+        }
+    }
+}
+
+void RERunner::publish() {
+    Snapshot &s = snapshots.prepare(mach->getMem(), mach->getCycles());
+    s.regs.resize(regs.size());
+    for(std::size_t i = 0; i < regs.size(); i++) {
+        s.regs[i] = regs[i]->get();
+    }
+    snapshots.publish();
+}
+
+void RERunner::loop() {
+    typedef std::chrono::steady_clock clock;
+
+    const uint64_t slice = (uint64_t)clk_khz * SLICE_US / 1000;
+    const std::chrono::microseconds slice_time(SLICE_US);
+
+    clock::time_point deadline = clock::now();
+    clock::time_point window = deadline;
+    clock::time_point published = deadline;
+    uint64_t window_cycles = 0;
+    bool was_running = false;
+
+    while(true) {
+        {
+            std::unique_lock<std::recursive_mutex> l(m);
+            cv.wait(l, [this] { return quit || running || !commands.empty(); });
+            if(quit) break;
+
+            apply();
+
+            if(!running) {
+                // Paused: only commands woke us up
+                publish();
+                was_running = false;
+                continue;
+            }
+
+            if(!was_running) {
+                deadline = window = clock::now();
+                window_cycles = 0;
+                was_running = true;
+            }
+
+            window_cycles += mach->runCycles(slice);
+
+            // A watch hit ends the slice early and leaves the machine
+            // stopped there
+            if(mach->getMem()->stopped()) {
+                running = false;
+                khz = 0;
+            }
+
+            // Publishing every slice would cost more than the slice itself
+            // when unthrottled; the UI only looks once a frame anyway
+            clock::time_point now = clock::now();
+            if(now - published >= std::chrono::microseconds(PUBLISH_US)) {
+                publish();
+                published = now;
+            }
+        }
+
+        while(waiting) std::this_thread::yield();
+
+        clock::time_point now = clock::now();
+        if(now - window >= std::chrono::seconds(1)) {
+            khz = window_cycles / std::chrono::duration<double, std::milli>(now - window).count();
+            window = now;
+            window_cycles = 0;
+        }
+
+        if(throttled) {
+            deadline += slice_time;
+            // Fall behind by more than a few slices (e.g. a debugger stall)
+            // and we resync instead of racing to catch up
+            if(now - deadline > 10 * slice_time) {
+                deadline = now;
+            }
+            std::this_thread::sleep_until(deadline);
+        }
+
+        if(!running) {
+            // Make sure the state we stopped in is the one on display
+            auto l = lock();
+            publish();
+            was_running = false;
+        }
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef __RUNNER_HPP
+#define __RUNNER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <common/machine.hpp>
+#include <common/snapshot.hpp>
+
+// Edits from a debugger, applied by the emulation thread between slices
+struct RECommand {
+    enum Type { WRITE_MEM, SET_REG, STEP, STEP_BACK, REVERSE_CONTINUE, RESET };
+
+    Type type;
+    uint32_t target; // Address, or register index in Registers::getAll() order
+    uint32_t value; // Data, or instruction count for STEP_BACK
+};
+
+// Runs a machine continuously on its own thread, in slices of SLICE_US of
+// emulated time. When throttled, each slice is paced against the machine
+// clock; otherwise slices run back to back.
+//
+// The machine is only touched by the emulation thread while it holds the
+// runner lock, which it takes once per slice. Debuggers should not need it:
+// they read snapshot() and send edits through post(). Anything else that
+// touches the machine directly must hold lock() for the duration. The lock
+// is recursive, so the control calls below may be made while holding it.
+class RERunner {
+public:
+    static constexpr uint32_t SLICE_US = 1000;
+    static constexpr uint32_t PUBLISH_US = 4000;
+
+    typedef RESnapshot<uint16_t, uint8_t> Snapshot;
+
+    RERunner(REMachine *mach);
+    ~RERunner();
+
+    // Also resumes from a watch hit on the machine's memory, which pauses
+    // the runner
+    void run();
+    void pause();
+    void step();
+    // Need rewind enabled on the machine
+    void stepBack(uint32_t n);
+    void reverseContinue();
+    bool isRunning();
+
+    void setThrottle(bool);
+    bool isThrottled();
+
+    std::unique_lock<std::recursive_mutex> lock();
+
+    // Emulated clock over the last second of running
+    double getKHz();
+
+    // Latest published state; only valid until the next call, and only
+    // one thread may read snapshots
+    const Snapshot &snapshot();
+
+    // Queues an edit; only one thread may post
+    bool post(RECommand cmd);
+
+private:
+    REMachine *mach;
+    uint32_t clk_khz;
+    std::vector<Register *> regs;
+
+    std::thread thread;
+    std::recursive_mutex m;
+    std::condition_variable_any cv;
+    std::atomic<bool> quit;
+    std::atomic<bool> running;
+    std::atomic<bool> throttled;
+    std::atomic<int> waiting;
+    std::atomic<double> khz;
+
+    RESnapshotChannel<uint16_t, uint8_t> snapshots;
+    RECommandQueue<RECommand, 1024> commands;
+
+    void loop();
+    void apply();
+    void publish();
+};
+
+#endif
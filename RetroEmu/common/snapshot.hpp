@@ -0,0 +1,103 @@
+#ifndef __SNAPSHOT_HPP
+#define __SNAPSHOT_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include <common/ram.hpp>
+
+// Copy of machine state as seen by a debugger
+template <typename A, typename D>
+struct RESnapshot {
+    uint64_t seq = 0;
+    uint64_t cycles = 0;
+    std::vector<uint32_t> regs;     // In Registers::getAll() order
+    std::vector<D> mem;             // The whole address space
+    std::vector<uint32_t> versions; // RAM page versions mem was copied at
+};
+
+// Triple buffer handing snapshots from the emulation thread to one reader.
+// Neither side ever waits: the writer fills the back buffer and swaps it
+// into the middle, the reader swaps the middle out whenever it is newer.
+template <typename A, typename D>
+class RESnapshotChannel {
+public:
+    RESnapshotChannel() : middle(1), back(2), front(0) {
+        for(auto &b : bufs) {
+            b.mem = std::vector<D>(RAM<A, D>::PAGE_COUNT * RAM<A, D>::PAGE_SIZE);
+            b.versions = std::vector<uint32_t>(RAM<A, D>::PAGE_COUNT, (uint32_t)-1);
+        }
+    }
+
+    // Writer side: only pages whose version moved are copied, so a
+    // publish costs roughly the memory written since the buffer was used
+    RESnapshot<A, D> &prepare(RAM<A, D> *mem, uint64_t cycles) {
+        RESnapshot<A, D> &b = bufs[back];
+        b.seq = ++seq;
+        b.cycles = cycles;
+        for(std::size_t pg = 0; pg < RAM<A, D>::PAGE_COUNT; pg++) {
+            uint32_t v = mem->version(pg);
+            if(b.versions[pg] != v) {
+                mem->peekPage(pg, &b.mem[pg << RAM<A, D>::PAGE_BITS]);
+                b.versions[pg] = v;
+            }
+        }
+        return b;
+    }
+
+    void publish() {
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // Reader side: the returned snapshot stays valid until the next call
+    const RESnapshot<A, D> &acquire() {
+        if(middle.load(std::memory_order_relaxed) & FRESH) {
+            front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+        }
+        return bufs[front];
+    }
+
+private:
+    static constexpr uint8_t INDEX = 0x03;
+    static constexpr uint8_t FRESH = 0x04;
+
+    RESnapshot<A, D> bufs[3];
+    std::atomic<uint8_t> middle;
+    uint8_t back;
+    uint8_t front;
+    uint64_t seq = 0;
+};
+
+// Single-producer, single-consumer ring, used for UI edits travelling to
+// the emulation thread. push() fails when the ring is full.
+template <typename T, std::size_t N>
+class RECommandQueue {
+public:
+    bool push(const T &item) {
+        std::size_t t = tail.load(std::memory_order_relaxed);
+        if(t - head.load(std::memory_order_acquire) == N) return false;
+        ring[t % N] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &item) {
+        std::size_t h = head.load(std::memory_order_relaxed);
+        if(h == tail.load(std::memory_order_acquire)) return false;
+        item = ring[h % N];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+private:
+    T ring[N];
+    std::atomic<std::size_t> head = 0;
+    std::atomic<std::size_t> tail = 0;
+};
+
+#endif
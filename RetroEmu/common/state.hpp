@@ -0,0 +1,101 @@
+#ifndef __STATE_HPP
+#define __STATE_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Save-state format: a header followed by whatever each component writes,
+// in a fixed order. Everything is stored in host byte order and layout;
+// states are meant for forking runs, not for archiving.
+#define RESTATE_MAGIC 0x54534552 // "REST"
+#define RESTATE_VERSION 2
+
+// FNV-1a, used to reference ROM contents instead of storing them
+inline uint64_t REStateHash(const void *buf, std::size_t n) {
+    const uint8_t *p = (const uint8_t *)buf;
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for(std::size_t i = 0; i < n; i++) {
+        h = (h ^ p[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+class REStateWriter {
+public:
+    REStateWriter(std::vector<uint8_t> &out) : out(out) {}
+
+    template <typename T>
+    void put(const T &v) { bytes(&v, sizeof(T)); }
+
+    void bytes(const void *buf, std::size_t n) {
+        const uint8_t *p = (const uint8_t *)buf;
+        out.insert(out.end(), p, p + n);
+    }
+
+    void str(const char *s) {
+        uint8_t n = strnlen(s, 255);
+        put(n);
+        bytes(s, n);
+    }
+
+    void header(const char *machine) {
+        put<uint32_t>(RESTATE_MAGIC);
+        put<uint32_t>(RESTATE_VERSION);
+        str(machine);
+    }
+
+private:
+    std::vector<uint8_t> &out;
+};
+
+// Reads fail soft: once anything is short or mismatched, every later
+// call returns false as well, so callers can check once at the end.
+class REStateReader {
+public:
+    REStateReader(const std::vector<uint8_t> &in) : in(in), pos(0), ok(true) {}
+
+    template <typename T>
+    bool get(T &v) { return bytes(&v, sizeof(T)); }
+
+    bool bytes(void *buf, std::size_t n) {
+        const uint8_t *p = view(n);
+        if(p) memcpy(buf, p, n);
+        return p;
+    }
+
+    // Points into the state buffer, for copying straight into place
+    const uint8_t *view(std::size_t n) {
+        if(!ok || in.size() - pos < n) {
+            ok = false;
+            return nullptr;
+        }
+        const uint8_t *p = in.data() + pos;
+        pos += n;
+        return p;
+    }
+
+    bool expectStr(const char *s) {
+        uint8_t n = 0;
+        if(!get(n) || n != strnlen(s, 255)) return ok = false;
+        const uint8_t *p = view(n);
+        if(!p || memcmp(p, s, n)) return ok = false;
+        return true;
+    }
+
+    bool header(const char *machine) {
+        uint32_t magic = 0, version = 0;
+        if(!get(magic) || !get(version)) return false;
+        if(magic != RESTATE_MAGIC || version != RESTATE_VERSION) return ok = false;
+        return expectStr(machine);
+    }
+
+    bool good() { return ok; }
+
+private:
+    const std::vector<uint8_t> &in;
+    std::size_t pos;
+    bool ok;
+};
+
+#endif
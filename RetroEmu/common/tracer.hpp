@@ -0,0 +1,173 @@
+#ifndef __TRACER_HPP
+#define __TRACER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <format>
+#include <new>
+#include <spdlog/spdlog.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define RETRACE_MAGIC "RETRACE"
+#define RETRACE_VERSION 1
+
+// Layout shared by trace files and in-memory traces: this header, padded
+// to 64 bytes, then the ring of records
+struct RETraceHeader {
+    char magic[8];
+    char kind[16];     // What the records are, such as "MOS6502"
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t capacity; // Records, a power of two
+    std::atomic<uint64_t> head; // Records written so far
+};
+
+// Fixed-size binary records in a ring that keeps the latest capacity of
+// them. With a path, the ring is a shared file mapping, so it is on disk
+// even if the process dies and any length of run can be recorded in
+// bounded space.
+//
+// One thread pushes. Readers may watch head from elsewhere: it is only
+// published once a record is complete, though the oldest records can be
+// overwritten while being read.
+template <typename R>
+class RETracer {
+public:
+    static constexpr std::size_t HEADER_SIZE = 64;
+    static_assert(sizeof(RETraceHeader) <= HEADER_SIZE);
+
+    RETracer(const char *kind, std::size_t capacity, const char *path = nullptr) {
+        std::size_t n = 1;
+        while(n * 2 <= capacity) n *= 2;
+        bytes = HEADER_SIZE + n * sizeof(R);
+
+        int fd = -1;
+        if(path) {
+            fd = open(path, O_CREAT | O_RDWR | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+            if(fd < 0 || ftruncate(fd, bytes) < 0) {
+                spdlog::error(std::format("Failed to create trace \"{}\"", path));
+                if(fd >= 0) close(fd);
+                return;
+            }
+        }
+
+        void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, path ? MAP_SHARED : MAP_PRIVATE | MAP_ANONYMOUS, fd, 0);
+        if(fd >= 0) close(fd);
+        if(p == MAP_FAILED) {
+            spdlog::error("Failed to map trace");
+            return;
+        }
+
+        header = new(p) RETraceHeader{};
+        memcpy(header->magic, RETRACE_MAGIC, sizeof(header->magic));
+        strncpy(header->kind, kind, sizeof(header->kind) - 1);
+        header->version = RETRACE_VERSION;
+        header->recordSize = sizeof(R);
+        header->capacity = n;
+        ring = (R *)((uint8_t *)p + HEADER_SIZE);
+        mask = n - 1;
+    }
+
+    ~RETracer() {
+        if(header) munmap(header, bytes);
+    }
+
+    RETracer(const RETracer &) = delete;
+    RETracer &operator=(const RETracer &) = delete;
+
+    bool good() {
+        return header != nullptr;
+    }
+
+    void push(const R &r) {
+        ring[pos & mask] = r;
+        header->head.store(++pos, std::memory_order_release);
+    }
+
+    uint64_t count() {
+        return pos;
+    }
+
+private:
+    RETraceHeader *header = nullptr;
+    R *ring = nullptr;
+    std::size_t bytes = 0;
+    uint64_t mask = 0;
+    uint64_t pos = 0;
+};
+
+// Reads back a trace file, oldest record first
+template <typename R>
+class RETraceReader {
+public:
+    RETraceReader(const char *path, const char *kind) {
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if(fd < 0 || fstat(fd, &st) < 0) {
+            spdlog::error(std::format("Failed to open \"{}\"", path));
+            if(fd >= 0) close(fd);
+            return;
+        }
+        bytes = st.st_size;
+        void *p = bytes >= RETracer<R>::HEADER_SIZE ? mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+        close(fd);
+        if(p == MAP_FAILED) {
+            spdlog::error(std::format("\"{}\" is not a trace", path));
+            bytes = 0;
+            return;
+        }
+        header = (const RETraceHeader *)p;
+
+        if(memcmp(header->magic, RETRACE_MAGIC, sizeof(header->magic)) || header->version != RETRACE_VERSION ||
+           strncmp(header->kind, kind, sizeof(header->kind)) || header->recordSize != sizeof(R) ||
+           bytes < RETracer<R>::HEADER_SIZE + header->capacity * sizeof(R)) {
+            spdlog::error(std::format("\"{}\" is not a {} trace", path, kind));
+            munmap(p, bytes);
+            header = nullptr;
+            return;
+        }
+
+        ring = (const R *)((const uint8_t *)p + RETracer<R>::HEADER_SIZE);
+        uint64_t head = header->head.load(std::memory_order_acquire);
+        n = std::min<uint64_t>(head, header->capacity);
+        first = head - n;
+    }
+
+    ~RETraceReader() {
+        if(header) munmap((void *)header, bytes);
+    }
+
+    RETraceReader(const RETraceReader &) = delete;
+    RETraceReader &operator=(const RETraceReader &) = delete;
+
+    bool good() {
+        return header != nullptr;
+    }
+
+    // Records still in the ring, and how many were dropped before them
+    uint64_t size() {
+        return n;
+    }
+
+    uint64_t dropped() {
+        return first;
+    }
+
+    const R &operator[](uint64_t i) {
+        return ring[(first + i) & (header->capacity - 1)];
+    }
+
+private:
+    const RETraceHeader *header = nullptr;
+    const R *ring = nullptr;
+    std::size_t bytes = 0;
+    uint64_t n = 0;
+    uint64_t first = 0;
+};
+
+#endif
@@ -1,65 +1,71 @@
+#include <cstring>
 #include <spdlog/spdlog.h>
 
 #include <cpu/6502.hpp>
-#include <gtest/gtest.h>
+#include <cpu/6502_opcodes.hpp>
 
 #define MEM (*mem)
-#define REG_PC (*(*regs)["PC"])
-#define REG_SP (*(*regs)["SP"])
-#define REG_FLAGS (*(*regs)["FLAGS"])
-#define REG_A (*(*regs)["A"])
-#define REG_X (*(*regs)["X"])
-#define REG_Y (*(*regs)["Y"])
-
-#define IS_CARRY()   (*REG_FLAGS & 0x01)
-#define IS_ZERO()    (*REG_FLAGS & 0x02)
-#define IS_INT_DIS() (*REG_FLAGS & 0x04)
-#define IS_DECIMAL() (*REG_FLAGS & 0x08)
-#define IS_BREAK()   (*REG_FLAGS & 0x10)
-#define IS_OVERFL()  (*REG_FLAGS & 0x40)
-#define IS_NEG()     (*REG_FLAGS & 0x80)
-
-#define SET_CARRY()   (REG_FLAGS = *REG_FLAGS | 0x01)
-#define SET_ZERO()    (REG_FLAGS = *REG_FLAGS | 0x02)
-#define SET_INT_DIS() (REG_FLAGS = *REG_FLAGS | 0x04)
-#define SET_DECIMAL() (REG_FLAGS = *REG_FLAGS | 0x08)
-#define SET_BREAK()   (REG_FLAGS = *REG_FLAGS | 0x10)
-#define SET_OVERFL()  (REG_FLAGS = *REG_FLAGS | 0x40)
-#define SET_NEG()     (REG_FLAGS = *REG_FLAGS | 0x80)
-
-#define CLR_CARRY()   (REG_FLAGS = *REG_FLAGS & ~0x01)
-#define CLR_ZERO()    (REG_FLAGS = *REG_FLAGS & ~0x02)
-#define CLR_INT_DIS() (REG_FLAGS = *REG_FLAGS & ~0x04)
-#define CLR_DECIMAL() (REG_FLAGS = *REG_FLAGS & ~0x08)
-#define CLR_BREAK()   (REG_FLAGS = *REG_FLAGS & ~0x10)
-#define CLR_OVERFL()  (REG_FLAGS = *REG_FLAGS & ~0x40)
-#define CLR_NEG()     (REG_FLAGS = *REG_FLAGS & ~0x80)
+#define REG_PC (s.pc)
+#define REG_SP (s.sp)
+#define REG_FLAGS (s.p)
+#define REG_A (s.a)
+#define REG_X (s.x)
+#define REG_Y (s.y)
+
+#define IS_CARRY()   (REG_FLAGS & 0x01)
+#define IS_ZERO()    (REG_FLAGS & 0x02)
+#define IS_INT_DIS() (REG_FLAGS & 0x04)
+#define IS_DECIMAL() (REG_FLAGS & 0x08)
+#define IS_BREAK()   (REG_FLAGS & 0x10)
+#define IS_OVERFL()  (REG_FLAGS & 0x40)
+#define IS_NEG()     (REG_FLAGS & 0x80)
+
+#define SET_CARRY()   (REG_FLAGS = REG_FLAGS | 0x01)
+#define SET_ZERO()    (REG_FLAGS = REG_FLAGS | 0x02)
+#define SET_INT_DIS() (REG_FLAGS = REG_FLAGS | 0x04)
+#define SET_DECIMAL() (REG_FLAGS = REG_FLAGS | 0x08)
+#define SET_BREAK()   (REG_FLAGS = REG_FLAGS | 0x10)
+#define SET_OVERFL()  (REG_FLAGS = REG_FLAGS | 0x40)
+#define SET_NEG()     (REG_FLAGS = REG_FLAGS | 0x80)
+
+#define CLR_CARRY()   (REG_FLAGS = REG_FLAGS & ~0x01)
+#define CLR_ZERO()    (REG_FLAGS = REG_FLAGS & ~0x02)
+#define CLR_INT_DIS() (REG_FLAGS = REG_FLAGS & ~0x04)
+#define CLR_DECIMAL() (REG_FLAGS = REG_FLAGS & ~0x08)
+#define CLR_BREAK()   (REG_FLAGS = REG_FLAGS & ~0x10)
+#define CLR_OVERFL()  (REG_FLAGS = REG_FLAGS & ~0x40)
+#define CLR_NEG()     (REG_FLAGS = REG_FLAGS & ~0x80)
 
 #define IMM data
 #define IMP data
-#define ACC *REG_A
+#define ACC REG_A
 #define ZERO MEM[data]
-#define ZERX MEM[(data+*REG_X) & 0xFF]
-#define ZERY MEM[(data+*REG_Y) & 0xFF]
+#define ZERX MEM[(data+REG_X) & 0xFF]
+#define ZERY MEM[(data+REG_Y) & 0xFF]
 #define REL data
 #define ABS ZERO
-#define ABSX MEM[data+*REG_X]
-#define ABSY MEM[data+*REG_Y]
-#define IND MEM[ZERO]
-#define INDX MEM[ZERX]
-#define INDY MEM[ZERO + *REG_Y]
+#define ABSX MEM[indexed(data, REG_X)]
+#define ABSY MEM[indexed(data, REG_Y)]
+// JMP's pointer high byte does not carry into the next page
+#define IND (MEM[data] | (MEM[(data & 0xFF00) | ((data + 1) & 0xFF)] << 8))
+#define INDX MEM[pointer(data + REG_X)]
+#define INDY MEM[indexed(pointer(data), REG_Y)]
 
-MOS6502::MOS6502(RAM<uint16_t, uint8_t> *mem) : mem(mem), init(false) {
+MOS6502::MOS6502(RAM<uint16_t, uint8_t> *mem, Core core) : init(false), core(CORE_TABLE), mem(mem), rewind(nullptr) {
+    setCore(core);
+
+    // save() writes the state whole, padding included
+    memset(&s, 0, sizeof(s));
 
     // gas = new GoodASM("6502");
     // gas->setListing("nasm");
     regs = new Registers();
-    regs->add("PC", new Register(16));
-    regs->add("SP", new Register(9, 0, Register::HEX, 0x0100));
-    regs->add("FLAGS", new Register(8, 0x04, Register::BIN, 0, 0x20, "CZIDB-VN"));
-    regs->add("A", new Register(8));
-    regs->add("X", new Register(8));
-    regs->add("Y", new Register(8));
+    regs->add("PC", new Register(&s.pc, 16));
+    regs->add("SP", new Register(&s.sp, 9, 0, Register::HEX, 0x0100));
+    regs->add("FLAGS", new Register(&s.p, 8, 0x04, Register::BIN, 0, 0x20, "CZIDB-VN"));
+    regs->add("A", new Register(&s.a, 8));
+    regs->add("X", new Register(&s.x, 8));
+    regs->add("Y", new Register(&s.y, 8));
 }
 
 void MOS6502::reset() {
@@ -73,6 +79,110 @@ Registers *MOS6502::getRegs() {
 
 MOS6502::~MOS6502() {
     // spdlog::debug("MOS6502::~MOS6502()");
+    delete rewind;
+    for(auto &r : *regs->getAll()) delete r.second;
+    delete regs;
+}
+
+void MOS6502::setCore(Core c) {
+    core = c;
+    if(core == CORE_TRACE && traces.empty()) traces = std::vector<TraceBlock>(TRACE_SLOTS, TraceBlock{});
+}
+
+MOS6502::Core MOS6502::getCore() {
+    return core;
+}
+
+void MOS6502::save(REStateWriter &w) {
+    w.put(s);
+    w.put<uint8_t>(init);
+    w.put(cycles);
+}
+
+bool MOS6502::load(REStateReader &r, bool apply) {
+    State saved;
+    uint8_t savedInit;
+    uint64_t savedCycles;
+    if(!r.get(saved) || !r.get(savedInit) || !r.get(savedCycles)) {
+        spdlog::error("Truncated CPU state");
+        return false;
+    }
+    if(!apply) return true;
+
+    s = saved;
+    init = savedInit;
+    cycles = savedCycles;
+    return true;
+}
+
+void MOS6502::setRewind(std::size_t budget) {
+    delete rewind;
+    rewind = budget ? new RERewind<Frame, uint16_t, uint8_t>(mem, budget) : nullptr;
+}
+
+uint64_t MOS6502::stepBack(uint64_t n) {
+    if(!rewind) return 0;
+
+    // Back to the nearest mark, then forward again to land on the target
+    uint64_t depth = rewind->depth();
+    Frame f = {s, init};
+    uint64_t replay = rewind->back(n, f, cycles);
+    s = f.s;
+    init = f.init;
+
+    // That history was already traced, profiled and stopped at
+    MOS6502Tracer *t = tracer;
+    MOS6502Profile *p = profile;
+    tracer = nullptr;
+    profile = nullptr;
+    replaying = true;
+    run(replay);
+    replaying = false;
+    tracer = t;
+    profile = p;
+    return depth - rewind->depth();
+}
+
+// History holds no record of watch hits, and watches may have been set
+// since, so it is replayed from the start with them live, noting where
+// each hit stopped it, until it gets back to here
+uint64_t MOS6502::reverseContinue() {
+    uint64_t depth = rewindDepth();
+    if(!depth) return 0;
+    stepBack(depth);
+
+    MOS6502Tracer *t = tracer;
+    MOS6502Profile *p = profile;
+    tracer = nullptr;
+    profile = nullptr;
+    uint64_t last = 0;
+    uint64_t at;
+    while((at = rewind->depth()) < depth) {
+        mem->resume();
+        run(depth - at);
+        at = rewind->depth();
+        if(at < depth) last = at;
+    }
+    mem->resume();
+    tracer = t;
+    profile = p;
+
+    stepBack(depth - last);
+    // Running on from a breakpoint runs the instruction there
+    breakPC = s.pc;
+    return depth - last;
+}
+
+void MOS6502::setTracer(MOS6502Tracer *t) {
+    tracer = t;
+}
+
+void MOS6502::setProfile(MOS6502Profile *p) {
+    profile = p;
+}
+
+uint64_t MOS6502::rewindDepth() {
+    return rewind ? rewind->depth() : 0;
 }
 
 void MOS6502::print() {
@@ -80,14 +190,14 @@ void MOS6502::print() {
 }
 
 void MOS6502::push(uint8_t data) {
-    mem->write(REG_SP--, data);
-    // spdlog::debug(std::format("{:04x}", *REG_SP));
+    mem->write(0x100 | REG_SP--, data);
+    // spdlog::debug(std::format("{:04x}", REG_SP));
 }
 
 uint8_t MOS6502::pop() {
     REG_SP++;
-    // spdlog::debug(std::format("{:04x}", *REG_SP));
-    return MEM[*REG_SP];
+    // spdlog::debug(std::format("{:04x}", REG_SP));
+    return MEM[0x100 | REG_SP];
 }
 
 uint8_t MOS6502::pullPC8() {
@@ -104,40 +214,122 @@ void MOS6502::step() {
     // spdlog::debug("MOS6502::step()");
 
     if(!init) {
+        if(rewind) rewind->mark({s, init}, cycles);
         init = true;
-        *((*regs)["PC"]) = ((*mem)[0xFFFD] << 8) + (*mem)[0xFFFC];
+        REG_PC = ((*mem)[0xFFFD] << 8) + (*mem)[0xFFFC];
+        cycles += 7;
+        if(rewind) rewind->advance(1);
         return;
     }
 
-    uint16_t origPC = *REG_PC;
+    breakPC = s.pc;
+    if(core != CORE_SWITCH) {
+        runTable(1);
+    } else {
+        stepSwitchRewind();
+    }
+    breakPC = -1;
+}
+
+uint64_t MOS6502::run(uint64_t n) {
+    uint64_t ran = 0;
+    if(n && !init) {
+        step();
+        n--;
+        ran++;
+    }
+
+    if(core != CORE_SWITCH) {
+        ran += runTable(n);
+    } else {
+        bool watched = mem->watching() && !replaying;
+        uint64_t i = 0;
+        for(; i < n && !(watched && halted()); i++) stepSwitchRewind();
+        ran += i;
+    }
+    return ran;
+}
+
+uint64_t MOS6502::runCycles(uint64_t n) {
+    uint64_t start = cycles;
+    uint64_t end = start + n;
+
+    if(n && !init) step();
+
+    if(core != CORE_SWITCH) {
+        runTableCycles(end);
+    } else {
+        bool watched = mem->watching();
+        while(cycles < end && !(watched && halted())) stepSwitchRewind();
+    }
+
+    return cycles - start;
+}
+
+// The switch core is only kept for comparison, so it just marks every
+// instruction rather than chunking runs like the table core
+void MOS6502::stepSwitchRewind() {
+    if(rewind) rewind->mark({s, init}, cycles);
+    if(tracer) {
+        MOS6502TraceRecord r = {cycles << 16 | s.pc, {mem->peek(s.pc), mem->peek(s.pc + 1), mem->peek(s.pc + 2)}, s.a, s.x, s.y, s.sp, s.p};
+        tracer->push(r);
+    }
+    if(profile) {
+        uint16_t pc = s.pc;
+        uint8_t sp = s.sp;
+        uint8_t opcode = mem->peek(pc);
+        uint64_t start = cycles;
+        stepSwitch();
+        profile->count(pc, opcode, cycles - start, sp, s.pc, s.sp, cycles);
+    } else {
+        stepSwitch();
+    }
+    if(rewind) rewind->advance(1);
+}
+
+void MOS6502::stepSwitch() {
+    uint16_t origPC = REG_PC;
 
     // Read first byte
     uint8_t opcode = pullPC8();
+    cycles += MOS6502_OPCODES[opcode].cycles;
 
     uint16_t result = 0;
     uint16_t data = 0;
+    uint16_t addr = 0;
 
     bool A7, B7, C7;
-    B7 = (*REG_A & 0x80);
+    B7 = (REG_A & 0x80);
+
+    // Reads through an indexed mode take a cycle more when indexing
+    // crosses a page; stores and read-modify-write have it in their count
+    auto indexed = [&](uint16_t base, uint8_t index) -> uint16_t {
+        uint16_t ea = base + index;
+        if((ea ^ base) & 0xFF00) cycles++;
+        return ea;
+    };
+    // Zero page pointers wrap within the zero page
+    auto pointer = [&](uint8_t zp) -> uint16_t {
+        return MEM[zp] | (MEM[(uint8_t)(zp + 1)] << 8);
+    };
 
     // FETCH / DECODE / EXECUTE
     switch(opcode) {
-    // ADC
+    // ADC (binary only: this core has no decimal mode)
     case 0x69:
         data = pullPC8();
         data = IMM;
     adc:
-        result = *REG_A + data + IS_CARRY();
+        result = REG_A + data + IS_CARRY();
         REG_A = result;
-    // TODO: Double-check carry and overflow
-    set_overflow:
         A7 = (data & 0x80);
         C7 = (result & 0x80);
         if((A7 == B7) && (A7 != C7)) SET_OVERFL(); else CLR_OVERFL();
     set_flags:
         if(result & 0x0100) SET_CARRY(); else CLR_CARRY();
-        if(*REG_A & 0x80) SET_NEG(); else CLR_NEG();
-        if(*REG_A) CLR_ZERO(); else SET_ZERO();
+    set_nz:
+        if(REG_A & 0x80) SET_NEG(); else CLR_NEG();
+        if(REG_A) CLR_ZERO(); else SET_ZERO();
         break;
     case 0x65:
         data = pullPC8();
@@ -173,9 +365,14 @@ void MOS6502::step() {
         data = pullPC8();
         data = IMM;
     sbc:
-        result = (uint16_t)*REG_A - (data + !IS_CARRY());
+        result = (uint16_t)REG_A - (data + !IS_CARRY());
+        A7 = (data & 0x80);
+        C7 = (result & 0x80);
+        if((A7 != B7) && (B7 != C7)) SET_OVERFL(); else CLR_OVERFL();
         REG_A = result;
-        goto set_overflow; // I think overflow works a bit differently here
+        // Carry is the inverse of the borrow out of bit 7
+        result ^= 0x0100;
+        goto set_flags;
     case 0xE5:
         data = pullPC8();
         data = ZERO;
@@ -210,8 +407,8 @@ void MOS6502::step() {
         data = pullPC8();
         data = IMM;
     and_i:
-        REG_A = *REG_A & data;
-        goto set_flags;
+        REG_A = REG_A & data;
+        goto set_nz;
     case 0x25:
         data = pullPC8();
         data = ZERO;
@@ -246,8 +443,8 @@ void MOS6502::step() {
         data = pullPC8();
         data = IMM;
     ora:
-        REG_A = *REG_A | data;
-        goto set_flags;
+        REG_A = REG_A | data;
+        goto set_nz;
     case 0x05:
         data = pullPC8();
         data = ZERO;
@@ -282,8 +479,8 @@ void MOS6502::step() {
         data = pullPC8();
         data = IMM;
     eor:
-        REG_A = *REG_A ^ data;
-        goto set_flags;
+        REG_A = REG_A ^ data;
+        goto set_nz;
     case 0x45:
         data = pullPC8();
         data = ZERO;
@@ -318,24 +515,30 @@ void MOS6502::step() {
         data = ACC;
     asl:
         result = data << 1;
-    set_a:
-        REG_A = result;
-        goto set_flags;
+    shifted:
+        // The accumulator forms are all $xA; the rest write back to addr
+        if((opcode & 0x0F) == 0x0A) {
+            REG_A = result;
+            goto set_flags;
+        }
+        mem->write(addr, result);
+        if(result & 0x0100) SET_CARRY(); else CLR_CARRY();
+        goto set_result_flags;
     case 0x06:
-        data = pullPC8();
-        data = ZERO;
+        addr = pullPC8();
+        data = MEM[addr];
         goto asl;
     case 0x16:
-        data = pullPC8();
-        data = ZERX;
+        addr = (pullPC8() + REG_X) & 0xFF;
+        data = MEM[addr];
         goto asl;
     case 0x0E:
-        data = pullPC16();
-        data = ABS;
+        addr = pullPC16();
+        data = MEM[addr];
         goto asl;
     case 0x1E:
-        data = pullPC16();
-        data = ABSX;
+        addr = pullPC16() + REG_X;
+        data = MEM[addr];
         goto asl;
 
     // LSR
@@ -343,22 +546,22 @@ void MOS6502::step() {
         data = ACC;
     lsr:
         result = (data >> 1) + ((data & 1) << 8);
-        goto set_a;
+        goto shifted;
     case 0x46:
-        data = pullPC8();
-        data = ZERO;
+        addr = pullPC8();
+        data = MEM[addr];
         goto lsr;
     case 0x56:
-        data = pullPC8();
-        data = ZERX;
+        addr = (pullPC8() + REG_X) & 0xFF;
+        data = MEM[addr];
         goto lsr;
     case 0x4E:
-        data = pullPC16();
-        data = ABS;
+        addr = pullPC16();
+        data = MEM[addr];
         goto lsr;
     case 0x5E:
-        data = pullPC16();
-        data = ABSX;
+        addr = pullPC16() + REG_X;
+        data = MEM[addr];
         goto lsr;
 
     // ROL
@@ -366,22 +569,22 @@ void MOS6502::step() {
         data = ACC;
     rol:
         result = ((data << 1) + IS_CARRY());
-        goto set_a;
+        goto shifted;
     case 0x26:
-        data = pullPC8();
-        data = ZERO;
+        addr = pullPC8();
+        data = MEM[addr];
         goto rol;
     case 0x36:
-        data = pullPC8();
-        data = ZERX;
+        addr = (pullPC8() + REG_X) & 0xFF;
+        data = MEM[addr];
         goto rol;
     case 0x2E:
-        data = pullPC16();
-        data = ABS;
+        addr = pullPC16();
+        data = MEM[addr];
         goto rol;
     case 0x3E:
-        data = pullPC16();
-        data = ABSX;
+        addr = pullPC16() + REG_X;
+        data = MEM[addr];
         goto rol;
 
     // ROR
@@ -389,22 +592,22 @@ void MOS6502::step() {
         data = ACC;
     ror:
         result = ((data >> 1) + (IS_CARRY() << 7) + ((data & 1) << 8));
-        goto set_a;
+        goto shifted;
     case 0x66:
-        data = pullPC8();
-        data = ZERO;
+        addr = pullPC8();
+        data = MEM[addr];
         goto ror;
     case 0x76:
-        data = pullPC8();
-        data = ZERX;
+        addr = (pullPC8() + REG_X) & 0xFF;
+        data = MEM[addr];
         goto ror;
     case 0x6E:
-        data = pullPC16();
-        data = ABS;
+        addr = pullPC16();
+        data = MEM[addr];
         goto ror;
     case 0x7E:
-        data = pullPC16();
-        data = ABSX;
+        addr = pullPC16() + REG_X;
+        data = MEM[addr];
         goto ror;
 
     // NOP
@@ -415,26 +618,33 @@ void MOS6502::step() {
     case 0x90:
         data = pullPC8();
         data = REL;
+        if(IS_CARRY()) break;
     rel_branch:
-        REG_PC = (int16_t)*REG_PC + (int8_t)data;
+        // Taken, a cycle more, and another into a different page
+        result = (int16_t)REG_PC + (int8_t)data;
+        cycles += ((result ^ REG_PC) & 0xFF00) ? 2 : 1;
+        REG_PC = result;
         break;
 
     // BCS
     case 0xB0:
         data = pullPC8();
         data = REL;
+        if(!IS_CARRY()) break;
         goto rel_branch;
 
     // BEQ
     case 0xF0:
         data = pullPC8();
         data = REL;
+        if(!IS_ZERO()) break;
         goto rel_branch;
 
     // BNE
     case 0xD0:
         data = pullPC8();
         data = REL;
+        if(IS_ZERO()) break;
         goto rel_branch;
 
     // BIT
@@ -442,7 +652,7 @@ void MOS6502::step() {
         data = pullPC8();
         data = ZERO;
     bit:
-        (*REG_A & data) ? CLR_ZERO() : SET_ZERO();
+        (REG_A & data) ? CLR_ZERO() : SET_ZERO();
         (data & 0x80) ? SET_NEG() : CLR_NEG();
         (data & 0x40) ? SET_OVERFL() : CLR_OVERFL();
         break;
@@ -455,34 +665,40 @@ void MOS6502::step() {
     case 0x30:
         data = pullPC8();
         data = REL;
+        if(!IS_NEG()) break;
         goto rel_branch;
 
     // BPL
     case 0x10:
         data = pullPC8();
         data = REL;
+        if(IS_NEG()) break;
         goto rel_branch;
 
     // BRK
     case 0x00:
         data = IMP;
-        push(*REG_PC >> 8);
-        push(*REG_PC & 0xFF);
-        push(*REG_FLAGS);
+        // Skips the byte after it; B is only set in the pushed copy
+        REG_PC++;
+        push(REG_PC >> 8);
+        push(REG_PC & 0xFF);
+        push(REG_FLAGS | 0x30);
+        SET_INT_DIS();
         REG_PC = (MEM[0xFFFF] << 8) + MEM[0xFFFE];
-        SET_BREAK();
         break;
 
     // BVC
     case 0x50:
         data = pullPC8();
         data = REL;
+        if(IS_OVERFL()) break;
         goto rel_branch;
 
     // BVS
     case 0x70:
         data = pullPC8();
         data = REL;
+        if(!IS_OVERFL()) break;
         goto rel_branch;
 
     // CLC
@@ -532,7 +748,9 @@ void MOS6502::step() {
         data = pullPC8();
         data = IMM;
     cmp:
-        result = *REG_A - data;
+        result = REG_A - data;
+    compared:
+        if(result & 0x0100) CLR_CARRY(); else SET_CARRY();
     set_result_flags:
         if(result & 0x80) SET_NEG(); else CLR_NEG();
         if(result & 0xFF) CLR_ZERO(); else SET_ZERO();
@@ -571,8 +789,8 @@ void MOS6502::step() {
         data = pullPC8();
         data = IMM;
     cpx:
-        result = *REG_X - data;
-        goto set_result_flags;
+        result = REG_X - data;
+        goto compared;
     case 0xE4:
         data = pullPC8();
         data = ZERO;
@@ -587,8 +805,8 @@ void MOS6502::step() {
         data = pullPC8();
         data = IMM;
     cpy:
-        result = *REG_Y - data;
-        goto set_result_flags;
+        result = REG_Y - data;
+        goto compared;
     case 0xC4:
         data = pullPC8();
         data = ZERO;
@@ -600,55 +818,45 @@ void MOS6502::step() {
 
     // DEC
     case 0xC6:
-        data = pullPC8();
-        result = ZERO;
-        mem->write(data, result-1);
-        break;
+        addr = pullPC8();
+    dec:
+        result = (uint8_t)(MEM[addr] - 1);
+        mem->write(addr, result);
+        goto set_result_flags;
     case 0xD6:
-        data = pullPC8();
-        result = ZERX;
-        mem->write((data+*REG_X) & 0xFF, result-1);
-        break;
+        addr = (pullPC8() + REG_X) & 0xFF;
+        goto dec;
     case 0xCE:
-        data = pullPC16();
-        result = ABS;
-        mem->write(data, result-1);
-        break;
+        addr = pullPC16();
+        goto dec;
     case 0xDE:
-        data = pullPC16();
-        data = ABSX;
-        mem->write(data+*REG_X, result-1);
-        break;
+        addr = pullPC16() + REG_X;
+        goto dec;
 
     // INC
     case 0xE6:
-        data = pullPC8();
-        data = ZERO;
-        mem->write(data, result+1);
-        break;
+        addr = pullPC8();
+    inc:
+        result = (uint8_t)(MEM[addr] + 1);
+        mem->write(addr, result);
+        goto set_result_flags;
     case 0xF6:
-        data = pullPC8();
-        data = ZERX;
-        mem->write((data+*REG_X) & 0xFF, result+1);
-        break;
+        addr = (pullPC8() + REG_X) & 0xFF;
+        goto inc;
     case 0xEE:
-        data = pullPC16();
-        data = ABS;
-        mem->write(data, result+1);
-        break;
+        addr = pullPC16();
+        goto inc;
     case 0xFE:
-        data = pullPC16();
-        data = ABSX;
-        mem->write(data+*REG_X, result+1);
-        break;
+        addr = pullPC16() + REG_X;
+        goto inc;
 
     // DEX
     case 0xCA:
         data = IMP;
         REG_X--;
     set_x_flags:
-        if(*REG_X & 0x80) SET_NEG(); else CLR_NEG();
-        if(*REG_X & 0xFF) CLR_ZERO(); else SET_ZERO();
+        if(REG_X & 0x80) SET_NEG(); else CLR_NEG();
+        if(REG_X & 0xFF) CLR_ZERO(); else SET_ZERO();
         break;
 
     // DEY
@@ -656,8 +864,8 @@ void MOS6502::step() {
         data = IMP;
         REG_Y--;
     set_y_flags:
-        if(*REG_Y & 0x80) SET_NEG(); else CLR_NEG();
-        if(*REG_Y & 0xFF) CLR_ZERO(); else SET_ZERO();
+        if(REG_Y & 0x80) SET_NEG(); else CLR_NEG();
+        if(REG_Y & 0xFF) CLR_ZERO(); else SET_ZERO();
         break;
 
     // INX
@@ -688,8 +896,8 @@ void MOS6502::step() {
     case 0x20:
         data = pullPC16();
         // data = ABS;
-        push((*REG_PC-1) >> 8);
-        push((*REG_PC-1) & 0xFF);
+        push((REG_PC-1) >> 8);
+        push((REG_PC-1) & 0xFF);
         goto jmp;
 
     // RTS
@@ -705,7 +913,7 @@ void MOS6502::step() {
         data = IMM;
     lda:
         REG_A = data;
-        goto set_flags;
+        goto set_nz;
     case 0xA5:
         data = pullPC8();
         data = ZERO;
@@ -772,7 +980,7 @@ void MOS6502::step() {
         goto ldy;
     case 0xB4:
         data = pullPC8();
-        data = ZERY;
+        data = ZERX;
         goto ldy;
     case 0xAC:
         data = pullPC16();
@@ -780,147 +988,147 @@ void MOS6502::step() {
         goto ldy;
     case 0xBC:
         data = pullPC16();
-        data = ABSY;
+        data = ABSX;
         goto ldy;
 
     // PHA
     case 0x48:
         data = IMP;
-        push(*REG_A);
+        push(REG_A);
         break;
 
     // PLA
     case 0x68:
         data = IMP;
         REG_A = pop();
-        goto set_flags;
+        goto set_nz;
 
     // PHP
     case 0x08:
         data = IMP;
-        push(*REG_FLAGS);
+        push(REG_FLAGS | 0x30);
         break;
 
     // PLP
     case 0x28:
         data = IMP;
-        REG_FLAGS = pop();
+        REG_FLAGS = pop() & ~0x30;
         break;
 
     // RTI
     case 0x40:
         data = IMP;
-        REG_FLAGS = pop();
-        REG_PC = pop();
-        REG_PC = pop() << 8;
+        REG_FLAGS = pop() & ~0x30;
+        data = pop();
+        REG_PC = data | (pop() << 8);
         break;
 
     // STA
     case 0x85:
         data = pullPC8();
         // data = ZERO;
-        mem->write(data, *REG_A);
+        mem->write(data, REG_A);
         break;
     case 0x95:
         data = pullPC8();
         // data = ZERX;
-        mem->write((data+*REG_X) & 0xFF, *REG_A);
+        mem->write((data+REG_X) & 0xFF, REG_A);
         break;
     case 0x8D:
         data = pullPC16();
         // data = ABS;
-        mem->write(data & 0xFF, *REG_A);
+        mem->write(data, REG_A);
         break;
     case 0x9D:
         data = pullPC16();
         // data = ABSX;
-        mem->write(data+*REG_X & 0xFF, *REG_A);
+        mem->write(data + REG_X, REG_A);
         break;
     case 0x99:
         data = pullPC16();
         // data = ABSY;
-        mem->write((data+*REG_Y) & 0xFF, *REG_A);
+        mem->write(data + REG_Y, REG_A);
         break;
     case 0x81:
         data = pullPC8();
         // data = INDX;
-        mem->write(ZERX, *REG_A);
+        mem->write(pointer(data + REG_X), REG_A);
         break;
     case 0x91:
         data = pullPC8();
         // data = INDY;
-        mem->write(ZERO+*REG_Y, *REG_A);
+        mem->write(pointer(data) + REG_Y, REG_A);
         break;
 
     // STX
     case 0x86:
         data = pullPC8();
         // data = ZERO;
-        mem->write(data, *REG_X);
+        mem->write(data, REG_X);
         break;
     case 0x96:
         data = pullPC8();
         // data = ZERY;
-        mem->write((data+*REG_Y) & 0xFF, *REG_X);
+        mem->write((data+REG_Y) & 0xFF, REG_X);
         break;
     case 0x8E:
         data = pullPC16();
         // data = ABS;
-        mem->write(data, *REG_X);
+        mem->write(data, REG_X);
         break;
 
     // STY
     case 0x84:
         data = pullPC8();
         // data = ZERO;
-        mem->write(data, *REG_Y);
+        mem->write(data, REG_Y);
         break;
     case 0x94:
         data = pullPC8();
-        // data = ZERY;
-        mem->write((data+*REG_Y) & 0xFF, *REG_Y);
+        // data = ZERX;
+        mem->write((data+REG_X) & 0xFF, REG_Y);
         break;
     case 0x8C:
         data = pullPC16();
         // data = ABS;
-        mem->write(data, *REG_Y);
+        mem->write(data, REG_Y);
         break;
 
     // TAX
     case 0xAA:
         data = IMP;
-        REG_X = *REG_A;
+        REG_X = REG_A;
         goto set_x_flags;
 
     // TAY
     case 0xA8:
         data = IMP;
-        REG_Y = *REG_A;
+        REG_Y = REG_A;
         goto set_y_flags;
 
     // TSX
     case 0xBA:
         data = IMP;
-        REG_X = *REG_SP;
+        REG_X = REG_SP;
         goto set_x_flags;
 
     // TXA
     case 0x8A:
         data = IMP;
-        REG_A = *REG_X;
-        goto set_flags;
+        REG_A = REG_X;
+        goto set_nz;
 
     // TXS
     case 0x9A:
         data = IMP;
-        REG_SP = *REG_X;
+        REG_SP = REG_X;
         break;
 
     // TYA
     case 0x98:
         data = IMP;
-        REG_A = *REG_Y;
-        goto set_flags;
+        REG_A = REG_Y;
+        goto set_nz;
 
     default:
         spdlog::error(std::format("Unknown opcode: {:02x} @ 0x{:04x}", opcode, origPC));
@@ -2,23 +2,155 @@
 #define MOS6502_H
 
 #include <cstdint>
-#include <goodasm.h>
+#include <vector>
 #include <common/cpu.hpp>
+#include <common/tracer.hpp>
+#include <cpu/6502_profile.hpp>
 
-class MOS6502 : RECPU<uint16_t, uint8_t> {
+// One instruction as recorded for tracing, before it runs
+struct MOS6502TraceRecord {
+    uint64_t word; // Cycles << 16 | PC
+    uint8_t op[3]; // Opcode and whatever operand bytes follow
+    uint8_t a;
+    uint8_t x;
+    uint8_t y;
+    uint8_t sp;
+    uint8_t p;
+};
+
+typedef RETracer<MOS6502TraceRecord> MOS6502Tracer;
+
+class MOS6502 : public RECPU<uint16_t, uint8_t> {
 public:
-    MOS6502(RAM<uint16_t,uint8_t> *);
+    // CORE_SWITCH is the original switch interpreter, kept for comparison;
+    // it has no decimal mode. CORE_TABLE dispatches through a 256-entry
+    // handler table (see 6502_table.cpp). CORE_TRACE is the table core plus
+    // a cache of pre-decoded hot blocks.
+    enum Core { CORE_SWITCH, CORE_TABLE, CORE_TRACE };
+
+    MOS6502(RAM<uint16_t,uint8_t> *, Core core = CORE_TABLE);
     ~MOS6502();
     void step();
+    // Returns how many instructions ran, fewer than n if a watch stopped it
+    uint64_t run(uint64_t n);
+    uint64_t runCycles(uint64_t n);
     void reset();
     void print();
     Registers *getRegs();
 
+    void setCore(Core);
+    Core getCore();
+
+    void save(REStateWriter &);
+    bool load(REStateReader &, bool apply = true);
+
+    // Records history for stepBack() within budget bytes; 0 turns it off
+    void setRewind(std::size_t budget);
+    uint64_t stepBack(uint64_t n);
+    uint64_t rewindDepth();
+    // Goes back to the last watch hit before here, or as far as history
+    // goes if there was none, and returns how many instructions back that
+    // was. The hit is not left pending.
+    uint64_t reverseContinue();
+
+    // Records every instruction run from now on; null stops. The caller
+    // keeps the tracer alive. Tracing runs on the table core.
+    void setTracer(MOS6502Tracer *);
+    // Likewise counts every instruction into a profile
+    void setProfile(MOS6502Profile *);
+
+    // Runs stop at watches set on the RAM (see RAM::watch()), leaving PC
+    // on the instruction an EXEC watch hit, until the RAM is resumed.
+    // step() runs the instruction at a breakpoint rather than stopping.
+
 private:
     bool init;
+    Core core;
     RAM<uint16_t, uint8_t> *mem;
     Registers *regs;
 
+    // Register file both cores execute on; regs is a view over it
+    struct State {
+        uint16_t pc;
+        uint8_t sp;
+        uint8_t p;
+        uint8_t a;
+        uint8_t x;
+        uint8_t y;
+    } s;
+
+    // What rewind restores before each instruction
+    struct Frame {
+        State s;
+        bool init;
+    };
+    RERewind<Frame, uint16_t, uint8_t> *rewind;
+    MOS6502Tracer *tracer = nullptr;
+    MOS6502Profile *profile = nullptr;
+
+    // Where the last run stopped at a breakpoint, so resuming from there
+    // runs that instruction rather than stopping again; -1 for none
+    int32_t breakPC = -1;
+    bool replaying = false;
+
+    // Whether a watch has stopped the run before the next instruction
+    bool halted() {
+        if(mem->stopped()) return true;
+        if(breakPC >= 0) {
+            bool resumed = breakPC == s.pc;
+            breakPC = -1;
+            if(resumed) return false;
+        }
+        // stopped() runs the hit's after check, which may drop it
+        if(!mem->breaks(s.pc) || !mem->stopped()) return false;
+        breakPC = s.pc;
+        return true;
+    }
+
+    // TRACE handlers take their operand from a pre-decoded op instead of
+    // fetching it
+    template <bool TRACE>
+    struct Ops;
+
+    // A straight run of instructions, decoded once it has been entered
+    // TRACE_HOT times. It ends at the first jump, branch or return. The
+    // source bytes are kept so a write to one of its pages only costs a
+    // compare unless it really changed the code.
+    static constexpr int TRACE_SLOTS = 256;
+    static constexpr int TRACE_OPS = 16;
+    static constexpr int TRACE_HOT = 8;
+
+    struct TraceOp {
+        void (*fn)(MOS6502 &);
+        uint16_t operand;
+        uint8_t len;
+        uint8_t cycles;
+        bool touches; // Accesses memory, so may write code or switch banks
+    };
+
+    struct TraceBlock {
+        uint16_t pc;
+        uint8_t hits;
+        uint8_t count;     // Ops decoded; 0 while the block is cold
+        uint8_t size;      // Source bytes
+        uint16_t maxCycles; // With every page-crossing penalty
+        const uint32_t *pages[2];
+        uint32_t versions[2];
+        TraceOp ops[TRACE_OPS];
+        uint8_t bytes[TRACE_OPS * 3];
+    };
+
+    // Direct-mapped on PC; only allocated for CORE_TRACE
+    std::vector<TraceBlock> traces;
+    uint16_t operand;
+
+    struct Trace;
+
+    void stepSwitch();
+    void stepSwitchRewind();
+    uint64_t runTable(uint64_t n);
+    void runTableCycles(uint64_t end);
+
     void push(uint8_t);
     uint8_t pop(void);
 
@@ -0,0 +1,29 @@
+#include <cstdio>
+
+#include <cpu/6502_disasm.hpp>
+#include <cpu/6502_opcodes.hpp>
+
+int disasm6502(const uint8_t *bytes, uint16_t addr, char *out, std::size_t n) {
+    const MOS6502Opcode &op = MOS6502_OPCODES[bytes[0]];
+    const char *m = op.mnemonic;
+    unsigned zp = bytes[1];
+    unsigned abs = bytes[1] | (bytes[2] << 8);
+
+    switch(op.mode) {
+    case MODE_IMP: snprintf(out, n, "%s", m); break;
+    case MODE_ACC: snprintf(out, n, "%s A", m); break;
+    case MODE_IMM: snprintf(out, n, "%s #$%02X", m, zp); break;
+    case MODE_ZP:  snprintf(out, n, "%s $%02X", m, zp); break;
+    case MODE_ZPX: snprintf(out, n, "%s $%02X,X", m, zp); break;
+    case MODE_ZPY: snprintf(out, n, "%s $%02X,Y", m, zp); break;
+    case MODE_ABS: snprintf(out, n, "%s $%04X", m, abs); break;
+    case MODE_ABX: snprintf(out, n, "%s $%04X,X", m, abs); break;
+    case MODE_ABY: snprintf(out, n, "%s $%04X,Y", m, abs); break;
+    case MODE_IND: snprintf(out, n, "%s ($%04X)", m, abs); break;
+    case MODE_IZX: snprintf(out, n, "%s ($%02X,X)", m, zp); break;
+    case MODE_IZY: snprintf(out, n, "%s ($%02X),Y", m, zp); break;
+    case MODE_REL: snprintf(out, n, "%s $%04X", m, (uint16_t)(addr + 2 + (int8_t)zp)); break;
+    }
+
+    return op.length;
+}
@@ -0,0 +1,14 @@
+#ifndef MOS6502_DISASM_H
+#define MOS6502_DISASM_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Longest line disasm6502() produces, including the terminator
+#define MOS6502_DISASM_MAX 16
+
+// Formats the instruction in bytes[0..2], located at addr, into out.
+// Never allocates. Returns the instruction length in bytes.
+int disasm6502(const uint8_t *bytes, uint16_t addr, char *out, std::size_t n);
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef MOS6502_OPCODES_H
+#define MOS6502_OPCODES_H
+
+#include <array>
+#include <cstdint>
+
+enum MOS6502Mode : uint8_t {
+    MODE_IMP, // Implied
+    MODE_ACC, // A
+    MODE_IMM, // #$nn
+    MODE_ZP,  // $nn
+    MODE_ZPX, // $nn,X
+    MODE_ZPY, // $nn,Y
+    MODE_ABS, // $nnnn
+    MODE_ABX, // $nnnn,X
+    MODE_ABY, // $nnnn,Y
+    MODE_IND, // ($nnnn)
+    MODE_IZX, // ($nn,X)
+    MODE_IZY, // ($nn),Y
+    MODE_REL, // Branch target
+};
+
+constexpr uint8_t MOS6502_MODE_LENGTH[] = {
+    1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 2, 2, 2,
+};
+
+struct MOS6502Opcode {
+    const char *mnemonic;
+    MOS6502Mode mode;
+    uint8_t length;
+    uint8_t cycles; // Before page-crossing and branch penalties
+};
+
+// Shared by the interpreter cores (lengths, cycles) and the disassembler.
+// Undocumented opcodes decode as one-byte "???".
+constexpr std::array<MOS6502Opcode, 256> MOS6502_OPCODES = [] {
+    constexpr uint8_t cycles[256] = {
+    //  0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F
+        7, 6, 2, 8, 3, 3, 5, 5, 3, 2, 2, 2, 4, 4, 6, 6, // 0
+        2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7, // 1
+        6, 6, 2, 8, 3, 3, 5, 5, 4, 2, 2, 2, 4, 4, 6, 6, // 2
+        2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7, // 3
+        6, 6, 2, 8, 3, 3, 5, 5, 3, 2, 2, 2, 3, 4, 6, 6, // 4
+        2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7, // 5
+        6, 6, 2, 8, 3, 3, 5, 5, 4, 2, 2, 2, 5, 4, 6, 6, // 6
+        2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7, // 7
+        2, 6, 2, 6, 3, 3, 3, 3, 2, 2, 2, 2, 4, 4, 4, 4, // 8
+        2, 6, 2, 6, 4, 4, 4, 4, 2, 5, 2, 5, 5, 5, 5, 5, // 9
+        2, 6, 2, 6, 3, 3, 3, 3, 2, 2, 2, 2, 4, 4, 4, 4, // A
+        2, 5, 2, 5, 4, 4, 4, 4, 2, 4, 2, 4, 4, 4, 4, 4, // B
+        2, 6, 2, 8, 3, 3, 5, 5, 2, 2, 2, 2, 4, 4, 6, 6, // C
+        2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7, // D
+        2, 6, 2, 8, 3, 3, 5, 5, 2, 2, 2, 2, 4, 4, 6, 6, // E
+        2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7, // F
+    };
+
+    struct { uint8_t op; const char *mnemonic; MOS6502Mode mode; } documented[] = {
+        {0x69, "ADC", MODE_IMM}, {0x65, "ADC", MODE_ZP},  {0x75, "ADC", MODE_ZPX}, {0x6D, "ADC", MODE_ABS},
+        {0x7D, "ADC", MODE_ABX}, {0x79, "ADC", MODE_ABY}, {0x61, "ADC", MODE_IZX}, {0x71, "ADC", MODE_IZY},
+        {0x29, "AND", MODE_IMM}, {0x25, "AND", MODE_ZP},  {0x35, "AND", MODE_ZPX}, {0x2D, "AND", MODE_ABS},
+        {0x3D, "AND", MODE_ABX}, {0x39, "AND", MODE_ABY}, {0x21, "AND", MODE_IZX}, {0x31, "AND", MODE_IZY},
+        {0x0A, "ASL", MODE_ACC}, {0x06, "ASL", MODE_ZP},  {0x16, "ASL", MODE_ZPX}, {0x0E, "ASL", MODE_ABS},
+        {0x1E, "ASL", MODE_ABX},
+        {0x90, "BCC", MODE_REL}, {0xB0, "BCS", MODE_REL}, {0xF0, "BEQ", MODE_REL}, {0x30, "BMI", MODE_REL},
+        {0xD0, "BNE", MODE_REL}, {0x10, "BPL", MODE_REL}, {0x50, "BVC", MODE_REL}, {0x70, "BVS", MODE_REL},
+        {0x24, "BIT", MODE_ZP},  {0x2C, "BIT", MODE_ABS},
+        {0x00, "BRK", MODE_IMP},
+        {0x18, "CLC", MODE_IMP}, {0xD8, "CLD", MODE_IMP}, {0x58, "CLI", MODE_IMP}, {0xB8, "CLV", MODE_IMP},
+        {0xC9, "CMP", MODE_IMM}, {0xC5, "CMP", MODE_ZP},  {0xD5, "CMP", MODE_ZPX}, {0xCD, "CMP", MODE_ABS},
+        {0xDD, "CMP", MODE_ABX}, {0xD9, "CMP", MODE_ABY}, {0xC1, "CMP", MODE_IZX}, {0xD1, "CMP", MODE_IZY},
+        {0xE0, "CPX", MODE_IMM}, {0xE4, "CPX", MODE_ZP},  {0xEC, "CPX", MODE_ABS},
+        {0xC0, "CPY", MODE_IMM}, {0xC4, "CPY", MODE_ZP},  {0xCC, "CPY", MODE_ABS},
+        {0xC6, "DEC", MODE_ZP},  {0xD6, "DEC", MODE_ZPX}, {0xCE, "DEC", MODE_ABS}, {0xDE, "DEC", MODE_ABX},
+        {0xCA, "DEX", MODE_IMP}, {0x88, "DEY", MODE_IMP},
+        {0x49, "EOR", MODE_IMM}, {0x45, "EOR", MODE_ZP},  {0x55, "EOR", MODE_ZPX}, {0x4D, "EOR", MODE_ABS},
+        {0x5D, "EOR", MODE_ABX}, {0x59, "EOR", MODE_ABY}, {0x41, "EOR", MODE_IZX}, {0x51, "EOR", MODE_IZY},
+        {0xE6, "INC", MODE_ZP},  {0xF6, "INC", MODE_ZPX}, {0xEE, "INC", MODE_ABS}, {0xFE, "INC", MODE_ABX},
+        {0xE8, "INX", MODE_IMP}, {0xC8, "INY", MODE_IMP},
+        {0x4C, "JMP", MODE_ABS}, {0x6C, "JMP", MODE_IND}, {0x20, "JSR", MODE_ABS},
+        {0xA9, "LDA", MODE_IMM}, {0xA5, "LDA", MODE_ZP},  {0xB5, "LDA", MODE_ZPX}, {0xAD, "LDA", MODE_ABS},
+        {0xBD, "LDA", MODE_ABX}, {0xB9, "LDA", MODE_ABY}, {0xA1, "LDA", MODE_IZX}, {0xB1, "LDA", MODE_IZY},
+        {0xA2, "LDX", MODE_IMM}, {0xA6, "LDX", MODE_ZP},  {0xB6, "LDX", MODE_ZPY}, {0xAE, "LDX", MODE_ABS},
+        {0xBE, "LDX", MODE_ABY},
+        {0xA0, "LDY", MODE_IMM}, {0xA4, "LDY", MODE_ZP},  {0xB4, "LDY", MODE_ZPX}, {0xAC, "LDY", MODE_ABS},
+        {0xBC, "LDY", MODE_ABX},
+        {0x4A, "LSR", MODE_ACC}, {0x46, "LSR", MODE_ZP},  {0x56, "LSR", MODE_ZPX}, {0x4E, "LSR", MODE_ABS},
+        {0x5E, "LSR", MODE_ABX},
+        {0xEA, "NOP", MODE_IMP},
+        {0x09, "ORA", MODE_IMM}, {0x05, "ORA", MODE_ZP},  {0x15, "ORA", MODE_ZPX}, {0x0D, "ORA", MODE_ABS},
+        {0x1D, "ORA", MODE_ABX}, {0x19, "ORA", MODE_ABY}, {0x01, "ORA", MODE_IZX}, {0x11, "ORA", MODE_IZY},
+        {0x48, "PHA", MODE_IMP}, {0x08, "PHP", MODE_IMP}, {0x68, "PLA", MODE_IMP}, {0x28, "PLP", MODE_IMP},
+        {0x2A, "ROL", MODE_ACC}, {0x26, "ROL", MODE_ZP},  {0x36, "ROL", MODE_ZPX}, {0x2E, "ROL", MODE_ABS},
+        {0x3E, "ROL", MODE_ABX},
+        {0x6A, "ROR", MODE_ACC}, {0x66, "ROR", MODE_ZP},  {0x76, "ROR", MODE_ZPX}, {0x6E, "ROR", MODE_ABS},
+        {0x7E, "ROR", MODE_ABX},
+        {0x40, "RTI", MODE_IMP}, {0x60, "RTS", MODE_IMP},
+        {0xE9, "SBC", MODE_IMM}, {0xE5, "SBC", MODE_ZP},  {0xF5, "SBC", MODE_ZPX}, {0xED, "SBC", MODE_ABS},
+        {0xFD, "SBC", MODE_ABX}, {0xF9, "SBC", MODE_ABY}, {0xE1, "SBC", MODE_IZX}, {0xF1, "SBC", MODE_IZY},
+        {0x38, "SEC", MODE_IMP}, {0xF8, "SED", MODE_IMP}, {0x78, "SEI", MODE_IMP},
+        {0x85, "STA", MODE_ZP},  {0x95, "STA", MODE_ZPX}, {0x8D, "STA", MODE_ABS}, {0x9D, "STA", MODE_ABX},
+        {0x99, "STA", MODE_ABY}, {0x81, "STA", MODE_IZX}, {0x91, "STA", MODE_IZY},
+        {0x86, "STX", MODE_ZP},  {0x96, "STX", MODE_ZPY}, {0x8E, "STX", MODE_ABS},
+        {0x84, "STY", MODE_ZP},  {0x94, "STY", MODE_ZPX}, {0x8C, "STY", MODE_ABS},
+        {0xAA, "TAX", MODE_IMP}, {0xA8, "TAY", MODE_IMP}, {0xBA, "TSX", MODE_IMP}, {0x8A, "TXA", MODE_IMP},
+        {0x9A, "TXS", MODE_IMP}, {0x98, "TYA", MODE_IMP},
+    };
+
+    std::array<MOS6502Opcode, 256> t{};
+    for(int i = 0; i < 256; i++) {
+        t[i] = {"???", MODE_IMP, 1, cycles[i]};
+    }
+    for(auto &d : documented) {
+        t[d.op] = {d.mnemonic, d.mode, MOS6502_MODE_LENGTH[d.mode], cycles[d.op]};
+    }
+    return t;
+}();
+
+#endif
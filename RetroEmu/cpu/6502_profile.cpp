@@ -0,0 +1,107 @@
+#include <algorithm>
+
+#include <cpu/6502_profile.hpp>
+
+MOS6502Profile::MOS6502Profile() {
+    clear();
+}
+
+void MOS6502Profile::clear() {
+    execs.assign(0x10000, 0);
+    cycleCounts.assign(0x10000, 0);
+    functions.assign(ROOT + 1, Function{});
+    edges.clear();
+    stack.clear();
+    current = ROOT;
+}
+
+uint64_t MOS6502Profile::getTotal() const {
+    uint64_t total = 0;
+    for(uint64_t c : cycleCounts) total += c;
+    return total;
+}
+
+void MOS6502Profile::enter(uint16_t fn, uint8_t sp, uint64_t now) {
+    // Code that never returns, such as a JSR used as a jump out of a
+    // loop, would grow this forever
+    if(stack.size() == MAX_FRAMES) stack.erase(stack.begin());
+
+    stack.push_back({fn, current, sp, now});
+    functions[fn].calls++;
+    edges[(uint64_t)current << 16 | fn].calls++;
+    current = fn;
+}
+
+void MOS6502Profile::leave(uint8_t sp, uint64_t now) {
+    // A frame has returned once the stack is back up to where it was
+    // before the call. The stack wraps, so "up" is within half of it.
+    while(!stack.empty() && (uint8_t)(sp - stack.back().sp) < 0x80) {
+        Frame f = stack.back();
+        stack.pop_back();
+
+        // Time in a recursive call is already inside the outer one
+        bool outer = std::none_of(stack.begin(), stack.end(), [&](const Frame &g) { return g.fn == f.fn; });
+        if(outer) {
+            functions[f.fn].inclusive += now - f.start;
+            edges[(uint64_t)f.caller << 16 | f.fn].cycles += now - f.start;
+        }
+        current = f.caller;
+    }
+}
+
+static void name(char *out, std::size_t n, uint32_t fn) {
+    if(fn == MOS6502Profile::ROOT) {
+        snprintf(out, n, "(top)");
+    } else {
+        snprintf(out, n, "$%04X", fn);
+    }
+}
+
+void MOS6502Profile::report(FILE *out, std::size_t top) const {
+    uint64_t total = getTotal();
+    double scale = total ? 100.0 / total : 0;
+    fprintf(out, "%llu cycles profiled\n", (unsigned long long)total);
+
+    std::vector<uint32_t> order;
+    for(uint32_t pc = 0; pc < 0x10000; pc++) {
+        if(execs[pc]) order.push_back(pc);
+    }
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return cycleCounts[a] > cycleCounts[b]; });
+    if(order.size() > top) order.resize(top);
+
+    fprintf(out, "\nHot spots\n%6s %12s %14s %7s\n", "PC", "execs", "cycles", "%");
+    for(uint32_t pc : order) {
+        fprintf(out, " $%04X %12llu %14llu %6.2f%%\n", pc, (unsigned long long)execs[pc],
+            (unsigned long long)cycleCounts[pc], cycleCounts[pc] * scale);
+    }
+
+    order.clear();
+    for(uint32_t fn = 0; fn <= ROOT; fn++) {
+        if(functions[fn].calls || functions[fn].exclusive) order.push_back(fn);
+    }
+    // ROOT never returns, so its inclusive time is everything
+    auto inclusive = [&](uint32_t fn) { return fn == ROOT ? total : functions[fn].inclusive; };
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return inclusive(a) > inclusive(b); });
+    if(order.size() > top) order.resize(top);
+
+    fprintf(out, "\nFunctions\n%6s %10s %14s %7s %14s %7s\n", "entry", "calls", "inclusive", "%", "exclusive", "%");
+    for(uint32_t fn : order) {
+        char s[8];
+        name(s, sizeof(s), fn);
+        const Function &f = functions[fn];
+        fprintf(out, "%6s %10llu %14llu %6.2f%% %14llu %6.2f%%\n", s, (unsigned long long)f.calls,
+            (unsigned long long)inclusive(fn), inclusive(fn) * scale, (unsigned long long)f.exclusive, f.exclusive * scale);
+    }
+
+    std::vector<std::pair<uint64_t, Edge>> calls(edges.begin(), edges.end());
+    std::sort(calls.begin(), calls.end(), [](auto &a, auto &b) { return a.second.cycles > b.second.cycles; });
+    if(calls.size() > top) calls.resize(top);
+
+    fprintf(out, "\nCalls\n%6s    %-6s %10s %14s\n", "caller", "callee", "calls", "cycles");
+    for(auto &[key, e] : calls) {
+        char caller[8], callee[8];
+        name(caller, sizeof(caller), key >> 16);
+        name(callee, sizeof(callee), key & 0xFFFF);
+        fprintf(out, "%6s -> %-6s %10llu %14llu\n", caller, callee, (unsigned long long)e.calls, (unsigned long long)e.cycles);
+    }
+}
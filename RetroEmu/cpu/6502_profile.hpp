@@ -0,0 +1,91 @@
+#ifndef MOS6502_PROFILE_H
+#define MOS6502_PROFILE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <unordered_map>
+#include <vector>
+
+// Where a program spends its time: executions and cycles for every PC,
+// and a call graph built from JSR and RTS. A function is known by its
+// entry address; code outside any call is charged to ROOT.
+//
+// Returns are matched on the stack pointer rather than by counting, so
+// code that drops its return address or returns through RTS to a pushed
+// address unwinds the right frames.
+class MOS6502Profile {
+public:
+    static constexpr uint32_t ROOT = 0x10000;
+
+    struct Function {
+        uint64_t calls;
+        uint64_t inclusive; // Cycles from entry to return, including callees
+        uint64_t exclusive; // Cycles in the function itself
+    };
+
+    struct Edge {
+        uint64_t calls;
+        uint64_t cycles; // Inclusive cycles of the callee from this caller
+    };
+
+    MOS6502Profile();
+    void clear();
+
+    // After each instruction: the PC, opcode and stack pointer it ran
+    // with, what it cost, and the PC and stack pointer it left
+    void count(uint16_t pc, uint8_t opcode, uint32_t cycles, uint8_t sp, uint16_t nextPC, uint8_t nextSP, uint64_t now) {
+        execs[pc]++;
+        cycleCounts[pc] += cycles;
+        functions[current].exclusive += cycles;
+        if(opcode == 0x20) {
+            enter(nextPC, sp, now);
+        } else if(opcode == 0x60) {
+            leave(nextSP, now);
+        }
+    }
+
+    uint64_t getExecs(uint16_t pc) const {
+        return execs[pc];
+    }
+
+    uint64_t getCycles(uint16_t pc) const {
+        return cycleCounts[pc];
+    }
+
+    uint64_t getTotal() const;
+
+    const Function &getFunction(uint32_t entry) const {
+        return functions[entry];
+    }
+
+    // Keyed by caller << 16 | callee, with ROOT as a caller
+    const std::unordered_map<uint64_t, Edge> &getEdges() const {
+        return edges;
+    }
+
+    // Plain text: the top hot spots, functions and calls by cycles
+    void report(FILE *out, std::size_t top = 32) const;
+
+private:
+    struct Frame {
+        uint32_t fn;
+        uint32_t caller;
+        uint8_t sp; // Before the JSR, which is where RTS leaves it
+        uint64_t start;
+    };
+
+    // Deeper than the 6502 stack can really go
+    static constexpr std::size_t MAX_FRAMES = 256;
+
+    std::vector<uint64_t> execs;
+    std::vector<uint64_t> cycleCounts;
+    std::vector<Function> functions; // By entry address, then ROOT
+    std::unordered_map<uint64_t, Edge> edges;
+    std::vector<Frame> stack;
+    uint32_t current = ROOT;
+
+    void enter(uint16_t fn, uint8_t sp, uint64_t now);
+    void leave(uint8_t sp, uint64_t now);
+};
+
+#endif
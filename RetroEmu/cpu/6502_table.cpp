@@ -0,0 +1,688 @@
+#include <algorithm>
+#include <array>
+#include <spdlog/spdlog.h>
+
+#include <cpu/6502.hpp>
+#include <cpu/6502_opcodes.hpp>
+
+// Table-driven core: one handler per opcode, with the addressing mode
+// resolved at compile time by template parameter. The trace tier runs the
+// same handlers, instantiated to take operands from pre-decoded ops.
+
+namespace {
+
+typedef MOS6502Mode Mode;
+
+enum Flag : uint8_t {
+    FLAG_C = 0x01,
+    FLAG_Z = 0x02,
+    FLAG_I = 0x04,
+    FLAG_D = 0x08,
+    FLAG_B = 0x10,
+    FLAG_U = 0x20,
+    FLAG_V = 0x40,
+    FLAG_N = 0x80,
+};
+
+}
+
+template <bool TRACE>
+struct MOS6502::Ops {
+    typedef void (*Handler)(MOS6502 &);
+
+    static uint8_t rd(MOS6502 &c, uint16_t addr) { return c.mem->read(addr); }
+    static void wr(MOS6502 &c, uint16_t addr, uint8_t data) { c.mem->write(addr, data); }
+
+    // Traced ops have PC past the whole instruction before they run
+    static uint8_t fetch8(MOS6502 &c) {
+        if constexpr (TRACE) return c.operand;
+        return rd(c, c.s.pc++);
+    }
+    static uint16_t fetch16(MOS6502 &c) {
+        if constexpr (TRACE) return c.operand;
+        uint16_t lo = fetch8(c);
+        return lo | (fetch8(c) << 8);
+    }
+
+    static void push(MOS6502 &c, uint8_t data) { wr(c, 0x100 | c.s.sp--, data); }
+    static uint8_t pop(MOS6502 &c) { return rd(c, 0x100 | ++c.s.sp); }
+
+    static void setFlag(MOS6502 &c, uint8_t flag, bool on) {
+        c.s.p = on ? (c.s.p | flag) : (c.s.p & ~flag);
+    }
+
+    static uint8_t setNZ(MOS6502 &c, uint8_t v) {
+        c.s.p = (c.s.p & ~(FLAG_N | FLAG_Z)) | (v & FLAG_N) | (v ? 0 : FLAG_Z);
+        return v;
+    }
+
+    // Effective address for memory operands. Reads through an indexed mode
+    // take an extra cycle when indexing crosses a page; stores and
+    // read-modify-write always pay it, so it is in their base count.
+    template <Mode M, bool PENALTY = false>
+    static uint16_t ea(MOS6502 &c) {
+        if constexpr (M == MODE_ZP) {
+            return fetch8(c);
+        } else if constexpr (M == MODE_ZPX) {
+            return (uint8_t)(fetch8(c) + c.s.x);
+        } else if constexpr (M == MODE_ZPY) {
+            return (uint8_t)(fetch8(c) + c.s.y);
+        } else if constexpr (M == MODE_ABS) {
+            return fetch16(c);
+        } else if constexpr (M == MODE_ABX) {
+            return indexed<PENALTY>(c, fetch16(c), c.s.x);
+        } else if constexpr (M == MODE_ABY) {
+            return indexed<PENALTY>(c, fetch16(c), c.s.y);
+        } else if constexpr (M == MODE_IND) {
+            // The pointer high byte does not carry into the next page
+            uint16_t ptr = fetch16(c);
+            return rd(c, ptr) | (rd(c, (ptr & 0xFF00) | ((ptr + 1) & 0xFF)) << 8);
+        } else if constexpr (M == MODE_IZX) {
+            uint8_t zp = fetch8(c) + c.s.x;
+            return rd(c, zp) | (rd(c, (uint8_t)(zp + 1)) << 8);
+        } else if constexpr (M == MODE_IZY) {
+            uint8_t zp = fetch8(c);
+            return indexed<PENALTY>(c, rd(c, zp) | (rd(c, (uint8_t)(zp + 1)) << 8), c.s.y);
+        } else {
+            static_assert(M == MODE_ZP, "addressing mode has no effective address");
+        }
+    }
+
+    template <bool PENALTY>
+    static uint16_t indexed(MOS6502 &c, uint16_t base, uint8_t index) {
+        uint16_t addr = base + index;
+        if constexpr (PENALTY) {
+            c.cycles += (addr ^ base) >> 8 ? 1 : 0;
+        }
+        return addr;
+    }
+
+    template <Mode M>
+    static uint8_t operand(MOS6502 &c) {
+        if constexpr (M == MODE_IMM) {
+            return fetch8(c);
+        } else {
+            return rd(c, ea<M, true>(c));
+        }
+    }
+
+    // ALU
+
+    static void doAdc(MOS6502 &c, uint8_t v) {
+        unsigned carry = c.s.p & FLAG_C;
+        unsigned a = c.s.a;
+
+        if(c.s.p & FLAG_D) {
+            // NMOS decimal mode: N and V come from the intermediate result,
+            // Z from the binary sum
+            int lo = (a & 0x0F) + (v & 0x0F) + carry;
+            if(lo >= 0x0A) lo = ((lo + 0x06) & 0x0F) + 0x10;
+            int r = (a & 0xF0) + (v & 0xF0) + lo;
+            int sr = (int8_t)(a & 0xF0) + (int8_t)(v & 0xF0) + lo;
+            setFlag(c, FLAG_N, r & 0x80);
+            setFlag(c, FLAG_V, sr < -128 || sr > 127);
+            setFlag(c, FLAG_Z, !((a + v + carry) & 0xFF));
+            if(r >= 0xA0) r += 0x60;
+            setFlag(c, FLAG_C, r >= 0x100);
+            c.s.a = r;
+        } else {
+            unsigned sum = a + v + carry;
+            setFlag(c, FLAG_C, sum > 0xFF);
+            setFlag(c, FLAG_V, ~(a ^ v) & (a ^ sum) & 0x80);
+            c.s.a = setNZ(c, sum);
+        }
+    }
+
+    static void doSbc(MOS6502 &c, uint8_t v) {
+        unsigned borrow = !(c.s.p & FLAG_C);
+        unsigned a = c.s.a;
+        unsigned diff = a - v - borrow;
+
+        // NMOS decimal mode sets all flags from the binary result
+        setFlag(c, FLAG_C, diff < 0x100);
+        setFlag(c, FLAG_V, (a ^ v) & (a ^ diff) & 0x80);
+        setNZ(c, diff);
+
+        if(c.s.p & FLAG_D) {
+            int lo = (int)(a & 0x0F) - (v & 0x0F) - (int)borrow;
+            if(lo < 0) lo = ((lo - 0x06) & 0x0F) - 0x10;
+            int r = (int)(a & 0xF0) - (v & 0xF0) + lo;
+            if(r < 0) r -= 0x60;
+            c.s.a = r;
+        } else {
+            c.s.a = diff;
+        }
+    }
+
+    static void compare(MOS6502 &c, uint8_t reg, uint8_t v) {
+        setFlag(c, FLAG_C, reg >= v);
+        setNZ(c, reg - v);
+    }
+
+    static uint8_t doAsl(MOS6502 &c, uint8_t v) {
+        setFlag(c, FLAG_C, v & 0x80);
+        return setNZ(c, v << 1);
+    }
+
+    static uint8_t doLsr(MOS6502 &c, uint8_t v) {
+        setFlag(c, FLAG_C, v & 0x01);
+        return setNZ(c, v >> 1);
+    }
+
+    static uint8_t doRol(MOS6502 &c, uint8_t v) {
+        uint8_t carry = c.s.p & FLAG_C;
+        setFlag(c, FLAG_C, v & 0x80);
+        return setNZ(c, (v << 1) | carry);
+    }
+
+    static uint8_t doRor(MOS6502 &c, uint8_t v) {
+        uint8_t carry = c.s.p & FLAG_C;
+        setFlag(c, FLAG_C, v & 0x01);
+        return setNZ(c, (v >> 1) | (carry << 7));
+    }
+
+    static uint8_t doInc(MOS6502 &c, uint8_t v) { return setNZ(c, v + 1); }
+    static uint8_t doDec(MOS6502 &c, uint8_t v) { return setNZ(c, v - 1); }
+
+    // Handlers
+
+    template <Mode M> static void adc(MOS6502 &c) { doAdc(c, operand<M>(c)); }
+    template <Mode M> static void sbc(MOS6502 &c) { doSbc(c, operand<M>(c)); }
+    template <Mode M> static void and_(MOS6502 &c) { c.s.a = setNZ(c, c.s.a & operand<M>(c)); }
+    template <Mode M> static void ora(MOS6502 &c) { c.s.a = setNZ(c, c.s.a | operand<M>(c)); }
+    template <Mode M> static void eor(MOS6502 &c) { c.s.a = setNZ(c, c.s.a ^ operand<M>(c)); }
+    template <Mode M> static void cmp(MOS6502 &c) { compare(c, c.s.a, operand<M>(c)); }
+    template <Mode M> static void cpx(MOS6502 &c) { compare(c, c.s.x, operand<M>(c)); }
+    template <Mode M> static void cpy(MOS6502 &c) { compare(c, c.s.y, operand<M>(c)); }
+    template <Mode M> static void lda(MOS6502 &c) { c.s.a = setNZ(c, operand<M>(c)); }
+    template <Mode M> static void ldx(MOS6502 &c) { c.s.x = setNZ(c, operand<M>(c)); }
+    template <Mode M> static void ldy(MOS6502 &c) { c.s.y = setNZ(c, operand<M>(c)); }
+    template <Mode M> static void sta(MOS6502 &c) { wr(c, ea<M>(c), c.s.a); }
+    template <Mode M> static void stx(MOS6502 &c) { wr(c, ea<M>(c), c.s.x); }
+    template <Mode M> static void sty(MOS6502 &c) { wr(c, ea<M>(c), c.s.y); }
+
+    template <Mode M>
+    static void bit(MOS6502 &c) {
+        uint8_t v = operand<M>(c);
+        setFlag(c, FLAG_Z, !(c.s.a & v));
+        c.s.p = (c.s.p & ~(FLAG_N | FLAG_V)) | (v & (FLAG_N | FLAG_V));
+    }
+
+    // Read-modify-write, on the accumulator or memory
+    template <Mode M, uint8_t (*F)(MOS6502 &, uint8_t)>
+    static void rmw(MOS6502 &c) {
+        if constexpr (M == MODE_ACC) {
+            c.s.a = F(c, c.s.a);
+        } else {
+            uint16_t addr = ea<M>(c);
+            wr(c, addr, F(c, rd(c, addr)));
+        }
+    }
+
+    template <uint8_t FLAG, bool SET>
+    static void branch(MOS6502 &c) {
+        int8_t offset = fetch8(c);
+        if(((c.s.p & FLAG) != 0) == SET) {
+            uint16_t target = c.s.pc + offset;
+            c.cycles += ((target ^ c.s.pc) >> 8) ? 2 : 1;
+            c.s.pc = target;
+        }
+    }
+
+    template <uint8_t FLAG, bool SET>
+    static void flag(MOS6502 &c) { setFlag(c, FLAG, SET); }
+
+    template <Mode M>
+    static void jmp(MOS6502 &c) { c.s.pc = ea<M>(c); }
+
+    static void jsr(MOS6502 &c) {
+        uint16_t addr = fetch16(c);
+        uint16_t ret = c.s.pc - 1;
+        push(c, ret >> 8);
+        push(c, ret & 0xFF);
+        c.s.pc = addr;
+    }
+
+    static void rts(MOS6502 &c) {
+        uint16_t lo = pop(c);
+        c.s.pc = (lo | (pop(c) << 8)) + 1;
+    }
+
+    static void rti(MOS6502 &c) {
+        c.s.p = pop(c) & ~(FLAG_B | FLAG_U);
+        uint16_t lo = pop(c);
+        c.s.pc = lo | (pop(c) << 8);
+    }
+
+    static void brk(MOS6502 &c) {
+        c.s.pc++;
+        push(c, c.s.pc >> 8);
+        push(c, c.s.pc & 0xFF);
+        push(c, c.s.p | FLAG_B | FLAG_U);
+        c.s.p |= FLAG_I;
+        c.s.pc = rd(c, 0xFFFE) | (rd(c, 0xFFFF) << 8);
+    }
+
+    static void pha(MOS6502 &c) { push(c, c.s.a); }
+    static void php(MOS6502 &c) { push(c, c.s.p | FLAG_B | FLAG_U); }
+    static void pla(MOS6502 &c) { c.s.a = setNZ(c, pop(c)); }
+    static void plp(MOS6502 &c) { c.s.p = pop(c) & ~(FLAG_B | FLAG_U); }
+
+    static void tax(MOS6502 &c) { c.s.x = setNZ(c, c.s.a); }
+    static void tay(MOS6502 &c) { c.s.y = setNZ(c, c.s.a); }
+    static void tsx(MOS6502 &c) { c.s.x = setNZ(c, c.s.sp); }
+    static void txa(MOS6502 &c) { c.s.a = setNZ(c, c.s.x); }
+    static void txs(MOS6502 &c) { c.s.sp = c.s.x; }
+    static void tya(MOS6502 &c) { c.s.a = setNZ(c, c.s.y); }
+    static void inx(MOS6502 &c) { c.s.x = setNZ(c, c.s.x + 1); }
+    static void iny(MOS6502 &c) { c.s.y = setNZ(c, c.s.y + 1); }
+    static void dex(MOS6502 &c) { c.s.x = setNZ(c, c.s.x - 1); }
+    static void dey(MOS6502 &c) { c.s.y = setNZ(c, c.s.y - 1); }
+    static void nop(MOS6502 &) {}
+
+    static void ill(MOS6502 &c) {
+        uint16_t pc = c.s.pc - 1;
+        spdlog::error(std::format("Unknown opcode: {:02x} @ 0x{:04x}", c.mem->read(pc), pc));
+    }
+
+    static constexpr std::array<Handler, 256> table = [] {
+        std::array<Handler, 256> t{};
+        for(auto &h : t) h = &ill;
+
+        t[0x69] = &adc<MODE_IMM>; t[0x65] = &adc<MODE_ZP>;  t[0x75] = &adc<MODE_ZPX>; t[0x6D] = &adc<MODE_ABS>;
+        t[0x7D] = &adc<MODE_ABX>; t[0x79] = &adc<MODE_ABY>; t[0x61] = &adc<MODE_IZX>; t[0x71] = &adc<MODE_IZY>;
+
+        t[0xE9] = &sbc<MODE_IMM>; t[0xE5] = &sbc<MODE_ZP>;  t[0xF5] = &sbc<MODE_ZPX>; t[0xED] = &sbc<MODE_ABS>;
+        t[0xFD] = &sbc<MODE_ABX>; t[0xF9] = &sbc<MODE_ABY>; t[0xE1] = &sbc<MODE_IZX>; t[0xF1] = &sbc<MODE_IZY>;
+
+        t[0x29] = &and_<MODE_IMM>; t[0x25] = &and_<MODE_ZP>;  t[0x35] = &and_<MODE_ZPX>; t[0x2D] = &and_<MODE_ABS>;
+        t[0x3D] = &and_<MODE_ABX>; t[0x39] = &and_<MODE_ABY>; t[0x21] = &and_<MODE_IZX>; t[0x31] = &and_<MODE_IZY>;
+
+        t[0x09] = &ora<MODE_IMM>; t[0x05] = &ora<MODE_ZP>;  t[0x15] = &ora<MODE_ZPX>; t[0x0D] = &ora<MODE_ABS>;
+        t[0x1D] = &ora<MODE_ABX>; t[0x19] = &ora<MODE_ABY>; t[0x01] = &ora<MODE_IZX>; t[0x11] = &ora<MODE_IZY>;
+
+        t[0x49] = &eor<MODE_IMM>; t[0x45] = &eor<MODE_ZP>;  t[0x55] = &eor<MODE_ZPX>; t[0x4D] = &eor<MODE_ABS>;
+        t[0x5D] = &eor<MODE_ABX>; t[0x59] = &eor<MODE_ABY>; t[0x41] = &eor<MODE_IZX>; t[0x51] = &eor<MODE_IZY>;
+
+        t[0xC9] = &cmp<MODE_IMM>; t[0xC5] = &cmp<MODE_ZP>;  t[0xD5] = &cmp<MODE_ZPX>; t[0xCD] = &cmp<MODE_ABS>;
+        t[0xDD] = &cmp<MODE_ABX>; t[0xD9] = &cmp<MODE_ABY>; t[0xC1] = &cmp<MODE_IZX>; t[0xD1] = &cmp<MODE_IZY>;
+
+        t[0xE0] = &cpx<MODE_IMM>; t[0xE4] = &cpx<MODE_ZP>; t[0xEC] = &cpx<MODE_ABS>;
+        t[0xC0] = &cpy<MODE_IMM>; t[0xC4] = &cpy<MODE_ZP>; t[0xCC] = &cpy<MODE_ABS>;
+
+        t[0x24] = &bit<MODE_ZP>; t[0x2C] = &bit<MODE_ABS>;
+
+        t[0xA9] = &lda<MODE_IMM>; t[0xA5] = &lda<MODE_ZP>;  t[0xB5] = &lda<MODE_ZPX>; t[0xAD] = &lda<MODE_ABS>;
+        t[0xBD] = &lda<MODE_ABX>; t[0xB9] = &lda<MODE_ABY>; t[0xA1] = &lda<MODE_IZX>; t[0xB1] = &lda<MODE_IZY>;
+
+        t[0xA2] = &ldx<MODE_IMM>; t[0xA6] = &ldx<MODE_ZP>; t[0xB6] = &ldx<MODE_ZPY>; t[0xAE] = &ldx<MODE_ABS>; t[0xBE] = &ldx<MODE_ABY>;
+        t[0xA0] = &ldy<MODE_IMM>; t[0xA4] = &ldy<MODE_ZP>; t[0xB4] = &ldy<MODE_ZPX>; t[0xAC] = &ldy<MODE_ABS>; t[0xBC] = &ldy<MODE_ABX>;
+
+        t[0x85] = &sta<MODE_ZP>;  t[0x95] = &sta<MODE_ZPX>; t[0x8D] = &sta<MODE_ABS>; t[0x9D] = &sta<MODE_ABX>;
+        t[0x99] = &sta<MODE_ABY>; t[0x81] = &sta<MODE_IZX>; t[0x91] = &sta<MODE_IZY>;
+        t[0x86] = &stx<MODE_ZP>; t[0x96] = &stx<MODE_ZPY>; t[0x8E] = &stx<MODE_ABS>;
+        t[0x84] = &sty<MODE_ZP>; t[0x94] = &sty<MODE_ZPX>; t[0x8C] = &sty<MODE_ABS>;
+
+        t[0x0A] = &rmw<MODE_ACC, doAsl>; t[0x06] = &rmw<MODE_ZP, doAsl>; t[0x16] = &rmw<MODE_ZPX, doAsl>;
+        t[0x0E] = &rmw<MODE_ABS, doAsl>; t[0x1E] = &rmw<MODE_ABX, doAsl>;
+        t[0x4A] = &rmw<MODE_ACC, doLsr>; t[0x46] = &rmw<MODE_ZP, doLsr>; t[0x56] = &rmw<MODE_ZPX, doLsr>;
+        t[0x4E] = &rmw<MODE_ABS, doLsr>; t[0x5E] = &rmw<MODE_ABX, doLsr>;
+        t[0x2A] = &rmw<MODE_ACC, doRol>; t[0x26] = &rmw<MODE_ZP, doRol>; t[0x36] = &rmw<MODE_ZPX, doRol>;
+        t[0x2E] = &rmw<MODE_ABS, doRol>; t[0x3E] = &rmw<MODE_ABX, doRol>;
+        t[0x6A] = &rmw<MODE_ACC, doRor>; t[0x66] = &rmw<MODE_ZP, doRor>; t[0x76] = &rmw<MODE_ZPX, doRor>;
+        t[0x6E] = &rmw<MODE_ABS, doRor>; t[0x7E] = &rmw<MODE_ABX, doRor>;
+        t[0xE6] = &rmw<MODE_ZP, doInc>; t[0xF6] = &rmw<MODE_ZPX, doInc>; t[0xEE] = &rmw<MODE_ABS, doInc>; t[0xFE] = &rmw<MODE_ABX, doInc>;
+        t[0xC6] = &rmw<MODE_ZP, doDec>; t[0xD6] = &rmw<MODE_ZPX, doDec>; t[0xCE] = &rmw<MODE_ABS, doDec>; t[0xDE] = &rmw<MODE_ABX, doDec>;
+
+        t[0x10] = &branch<FLAG_N, false>; t[0x30] = &branch<FLAG_N, true>;
+        t[0x50] = &branch<FLAG_V, false>; t[0x70] = &branch<FLAG_V, true>;
+        t[0x90] = &branch<FLAG_C, false>; t[0xB0] = &branch<FLAG_C, true>;
+        t[0xD0] = &branch<FLAG_Z, false>; t[0xF0] = &branch<FLAG_Z, true>;
+
+        t[0x18] = &flag<FLAG_C, false>; t[0x38] = &flag<FLAG_C, true>;
+        t[0x58] = &flag<FLAG_I, false>; t[0x78] = &flag<FLAG_I, true>;
+        t[0xD8] = &flag<FLAG_D, false>; t[0xF8] = &flag<FLAG_D, true>;
+        t[0xB8] = &flag<FLAG_V, false>;
+
+        t[0x4C] = &jmp<MODE_ABS>; t[0x6C] = &jmp<MODE_IND>;
+        t[0x20] = &jsr; t[0x60] = &rts; t[0x40] = &rti; t[0x00] = &brk;
+
+        t[0x48] = &pha; t[0x08] = &php; t[0x68] = &pla; t[0x28] = &plp;
+        t[0xAA] = &tax; t[0xA8] = &tay; t[0xBA] = &tsx; t[0x8A] = &txa; t[0x9A] = &txs; t[0x98] = &tya;
+        t[0xE8] = &inx; t[0xC8] = &iny; t[0xCA] = &dex; t[0x88] = &dey;
+        t[0xEA] = &nop;
+
+        return t;
+    }();
+
+    static void exec(MOS6502 &c) {
+        uint8_t opcode = fetch8(c);
+        c.cycles += MOS6502_OPCODES[opcode].cycles;
+        table[opcode](c);
+    }
+
+    // What the run loops below do around each instruction. Each policy
+    // gets its own instantiation of them, so the plain loop carries no
+    // trace of tracing, profiling or watches.
+    template <bool TRACED, bool PROFILED, bool WATCHED>
+    struct Policy {
+        // Whether to run the next instruction
+        static bool more(MOS6502 &c) {
+            if constexpr (WATCHED) {
+                return !c.halted();
+            }
+            return true;
+        }
+
+        static void exec(MOS6502 &c) {
+            uint16_t pc = c.s.pc;
+            if constexpr (TRACED) {
+                MOS6502TraceRecord r = {c.cycles << 16 | pc, {c.mem->peek(pc), c.mem->peek(pc + 1), c.mem->peek(pc + 2)},
+                                        c.s.a, c.s.x, c.s.y, c.s.sp, c.s.p};
+                c.tracer->push(r);
+            }
+            if constexpr (PROFILED) {
+                uint8_t sp = c.s.sp;
+                uint8_t opcode = c.mem->peek(pc);
+                uint64_t start = c.cycles;
+                Ops::exec(c);
+                c.profile->count(pc, opcode, c.cycles - start, sp, c.s.pc, c.s.sp, c.cycles);
+            } else {
+                Ops::exec(c);
+            }
+        }
+    };
+
+    typedef Policy<false, false, false> Plain;
+
+    // Calls f.template operator()<P>() with the policy for the hooks that
+    // are set
+    template <bool T, bool P, bool W, typename F>
+    static void hooked(F f) {
+        f.template operator()<Policy<T, P, W>>();
+    }
+
+    template <bool T, bool P, typename F>
+    static void hooked(F f, bool w) {
+        w ? hooked<T, P, true>(f) : hooked<T, P, false>(f);
+    }
+
+    template <bool T, typename F>
+    static void hooked(F f, bool p, bool w) {
+        p ? hooked<T, true>(f, w) : hooked<T, false>(f, w);
+    }
+
+    template <typename F>
+    static void hooked(F f, bool t, bool p, bool w) {
+        t ? hooked<true>(f, p, w) : hooked<false>(f, p, w);
+    }
+
+    // While recording for rewind, runs are cut into chunks with a mark
+    // before each; the instruction loop itself is the same
+    typedef RERewind<Frame, uint16_t, uint8_t> Rewind;
+
+    // Returns how many instructions ran, fewer than n if stopped
+    template <typename P>
+    static uint64_t run(MOS6502 &c, uint64_t n) {
+        uint64_t i = 0;
+        while(i < n && P::more(c)) {
+            P::exec(c);
+            i++;
+        }
+        return i;
+    }
+
+    template <typename P>
+    static uint64_t runRewind(MOS6502 &c, uint64_t n) {
+        uint64_t total = 0;
+        while(n) {
+            uint64_t chunk = std::min<uint64_t>(n, Rewind::INTERVAL);
+            c.rewind->mark({c.s, true}, c.cycles);
+            uint64_t ran = run<P>(c, chunk);
+            c.rewind->advance(ran);
+            total += ran;
+            if(ran < chunk) break;
+            n -= chunk;
+        }
+        return total;
+    }
+
+    template <typename P>
+    static void runCycles(MOS6502 &c, uint64_t end) {
+        while(c.cycles < end && P::more(c)) P::exec(c);
+    }
+
+    template <typename P>
+    static void runCyclesRewind(MOS6502 &c, uint64_t end) {
+        while(c.cycles < end) {
+            c.rewind->mark({c.s, true}, c.cycles);
+            uint32_t chunk = 0;
+            bool more = true;
+            while(c.cycles < end && chunk < Rewind::INTERVAL && (more = P::more(c))) {
+                P::exec(c);
+                chunk++;
+            }
+            c.rewind->advance(chunk);
+            if(!more) break;
+        }
+    }
+
+    template <typename P>
+    static uint64_t runAny(MOS6502 &c, uint64_t n) {
+        return c.rewind ? runRewind<P>(c, n) : run<P>(c, n);
+    }
+
+    template <typename P>
+    static void runCyclesAny(MOS6502 &c, uint64_t end) {
+        if(c.rewind) {
+            runCyclesRewind<P>(c, end);
+        } else {
+            runCycles<P>(c, end);
+        }
+    }
+};
+
+// Trace tier: looks the PC up in the block cache, and runs the block if it
+// is hot and its source has not changed, or a single instruction on the
+// table core if not
+struct MOS6502::Trace {
+    typedef MOS6502::Ops<false> Table;
+
+    enum : uint8_t { KIND_NONE, KIND_OP, KIND_END };
+
+    // Blocks end after anything that can change PC other than by falling
+    // through; undocumented opcodes are left to the table core
+    static constexpr std::array<uint8_t, 256> kinds = [] {
+        auto is = [](const char *a, const char *b) {
+            while(*a && *a == *b) a++, b++;
+            return *a == *b;
+        };
+        std::array<uint8_t, 256> k{};
+        for(int i = 0; i < 256; i++) {
+            const MOS6502Opcode &o = MOS6502_OPCODES[i];
+            if(is(o.mnemonic, "???")) {
+                k[i] = KIND_NONE;
+            } else if(o.mode == MODE_REL || is(o.mnemonic, "JMP") || is(o.mnemonic, "JSR") ||
+                      is(o.mnemonic, "RTS") || is(o.mnemonic, "RTI") || is(o.mnemonic, "BRK")) {
+                k[i] = KIND_END;
+            } else {
+                k[i] = KIND_OP;
+            }
+        }
+        return k;
+    }();
+
+    static TraceBlock &slot(MOS6502 &c, uint16_t pc) {
+        return c.traces[(pc ^ (pc >> 7)) & (TRACE_SLOTS - 1)];
+    }
+
+    static bool translate(MOS6502 &c, TraceBlock &b) {
+        RAM<uint16_t, uint8_t> *mem = c.mem;
+        uint32_t pc = b.pc;
+        b.count = 0;
+        b.size = 0;
+        b.maxCycles = 0;
+        uint32_t first = pc >> 8;
+
+        while(b.count < TRACE_OPS) {
+            uint8_t opcode = mem->peek(pc);
+            const MOS6502Opcode &o = MOS6502_OPCODES[opcode];
+            uint32_t last = pc + o.length - 1;
+
+            // Only plain, unwatched memory, and no more than two pages of
+            // it, so checking a block stays cheap. Its bytes are not
+            // fetched through the RAM, so breakpoints and read watches
+            // there would never see them.
+            if(kinds[opcode] == KIND_NONE || last > 0xFFFF || (last >> 8) > first + 1) break;
+            if(!mem->direct(pc) || !mem->direct(last) || mem->watched(pc) || mem->watched(last)) break;
+
+            uint16_t operand = 0;
+            for(int i = 0; i < o.length; i++) {
+                uint8_t byte = mem->peek(pc + i);
+                b.bytes[b.size++] = byte;
+                if(i) operand |= byte << (8 * (i - 1));
+            }
+            bool stack = opcode == 0x48 || opcode == 0x08 || opcode == 0x68 || opcode == 0x28;
+            bool touches = stack || !(o.mode == MODE_IMP || o.mode == MODE_ACC || o.mode == MODE_IMM);
+            b.ops[b.count++] = {Ops<true>::table[opcode], operand, o.length, o.cycles, touches};
+            b.maxCycles += o.cycles + 2; // At most a taken branch across pages
+            pc += o.length;
+
+            if(kinds[opcode] == KIND_END) break;
+        }
+        if(!b.count) return false;
+
+        b.pages[0] = mem->versionPtr(first);
+        b.pages[1] = mem->versionPtr((pc - 1) >> 8);
+        b.versions[0] = *b.pages[0];
+        b.versions[1] = *b.pages[1];
+        return true;
+    }
+
+    static bool stale(const TraceBlock &b) {
+        return *b.pages[0] != b.versions[0] || *b.pages[1] != b.versions[1];
+    }
+
+    // A page of the block was written, remapped or watched: keep it if the
+    // bytes are still the same and unwatched, otherwise drop it
+    static bool recheck(MOS6502 &c, TraceBlock &b) {
+        for(int i = 0; i < b.size; i++) {
+            if(!c.mem->direct(b.pc + i) || c.mem->watched(b.pc + i) || c.mem->peek(b.pc + i) != b.bytes[i]) {
+                b.count = 0;
+                b.hits = 0;
+                return false;
+            }
+        }
+        b.versions[0] = *b.pages[0];
+        b.versions[1] = *b.pages[1];
+        return true;
+    }
+
+    // Whatever a traced op wrote or switched may have been the code that
+    // follows it. With watches set, an access that hit one ends the block
+    // after the op, as the run stops there.
+    template <bool WATCHED>
+    static bool step(MOS6502 &c, TraceBlock &b, const TraceOp &op) {
+        c.s.pc += op.len;
+        c.operand = op.operand;
+        c.cycles += op.cycles;
+        op.fn(c);
+        if(!op.touches) return true;
+        if constexpr (WATCHED) {
+            if(c.mem->stopped()) return false;
+        }
+        return !stale(b) || recheck(c, b);
+    }
+
+    // Runs up to n instructions, stopping once cycles reach end, and
+    // returns how many ran. With WATCHED it also stops where the table
+    // core would for a watch; blocks never start on a watched page, so
+    // checking between blocks is enough for breakpoints.
+    template <bool WATCHED>
+    static uint64_t run(MOS6502 &c, uint64_t n, uint64_t end) {
+        uint64_t done = 0;
+        while(done < n && c.cycles < end) {
+            if constexpr (WATCHED) {
+                if(c.halted()) break;
+            }
+            TraceBlock &b = slot(c, c.s.pc);
+            if(b.pc != c.s.pc) {
+                b.pc = c.s.pc;
+                b.hits = 0;
+                b.count = 0;
+            }
+
+            bool ready = b.count && (!stale(b) || recheck(c, b));
+            if(!ready && ++b.hits >= TRACE_HOT) {
+                b.hits = 0;
+                ready = translate(c, b);
+            }
+            if(!ready) {
+                Table::exec(c);
+                done++;
+                continue;
+            }
+
+            // Only check the limits per op when the block might cross them
+            int i = 0;
+            if(n - done >= b.count && end - c.cycles > b.maxCycles) {
+                while(i < b.count && step<WATCHED>(c, b, b.ops[i++]));
+            } else {
+                while(i < b.count && done + i < n && c.cycles < end && step<WATCHED>(c, b, b.ops[i++]));
+            }
+            done += i;
+        }
+        return done;
+    }
+
+    // Chunked between rewind marks just like the table core
+    template <bool WATCHED>
+    static uint64_t runMarked(MOS6502 &c, uint64_t n, uint64_t end) {
+        if(!c.rewind) return run<WATCHED>(c, n, end);
+        uint64_t total = 0;
+        while(n && c.cycles < end) {
+            uint64_t chunk = std::min<uint64_t>(n, Table::Rewind::INTERVAL);
+            c.rewind->mark({c.s, true}, c.cycles);
+            uint64_t done = run<WATCHED>(c, chunk, end);
+            c.rewind->advance(done);
+            total += done;
+            n -= done;
+            if(done < chunk && c.cycles < end) break; // Stopped at a watch
+        }
+        return total;
+    }
+
+    static uint64_t runMarked(MOS6502 &c, uint64_t n, uint64_t end, bool watched) {
+        return watched ? runMarked<true>(c, n, end) : runMarked<false>(c, n, end);
+    }
+};
+
+// Tracing and profiling need a hook on every instruction, which trace
+// blocks don't have, so they always run on the table core. Watches only
+// keep blocks off the pages they cover. Replays for rewind go without any
+// of them: that history was already seen.
+uint64_t MOS6502::runTable(uint64_t n) {
+    typedef Ops<false> O;
+    bool watched = mem->watching() && !replaying;
+    if(tracer || profile || (watched && core != CORE_TRACE)) {
+        uint64_t ran = 0;
+        O::hooked([&]<typename P>() { ran = O::runAny<P>(*this, n); }, tracer, profile, watched);
+        return ran;
+    } else if(core == CORE_TRACE) {
+        return Trace::runMarked(*this, n, UINT64_MAX, watched);
+    } else {
+        return O::runAny<O::Plain>(*this, n);
+    }
+}
+
+void MOS6502::runTableCycles(uint64_t end) {
+    typedef Ops<false> O;
+    bool watched = mem->watching();
+    if(tracer || profile || (watched && core != CORE_TRACE)) {
+        O::hooked([&]<typename P>() { O::runCyclesAny<P>(*this, end); }, tracer, profile, watched);
+    } else if(core == CORE_TRACE) {
+        Trace::runMarked(*this, UINT64_MAX, end, watched);
+    } else {
+        O::runCyclesAny<O::Plain>(*this, end);
+    }
+}
@@ -13,8 +13,9 @@ AppleIIe::AppleIIe() {
 
 
     mem = new RAM<uint16_t, uint8_t>();
-    mem->mapMem("", 0, 0xF800, true);
     mem->mapFil("monitor", 0xF800, 0, "/home/brian/RetroDevToolkit/rom/apple2e_F8.bin");
+    const uint8_t *rom = mem->ptr(0xF800);
+    mapMemory(rom, rom ? 0x800 : 0);
     mem->printMap();
 
     this->cpu = new MOS6502(mem);
@@ -22,16 +23,74 @@ AppleIIe::AppleIIe() {
 
 }
 
+AppleIIe::AppleIIe(const uint8_t *rom, std::size_t n) {
+    mem = new RAM<uint16_t, uint8_t>();
+    mem->mapBuf("monitor", 0x10000 - n, n, (uint8_t *)rom); // Read-only, never written
+    mapMemory(rom, n);
+
+    cpu = new MOS6502(mem);
+    clk_khz = CPU_FREQ_KHZ;
+}
+
+AppleIIe::AppleIIe(const AppleIIe &parent, std::shared_ptr<const RAM<uint16_t, uint8_t>::Image> image) {
+    mem = new RAM<uint16_t, uint8_t>(image);
+    cpu = new MOS6502(mem, parent.cpu->getCore());
+    clk_khz = parent.clk_khz;
+
+    // The image still points at the parent's I/O page, and leaves the
+    // banks for our MMU to point at our copies of the blocks
+    io.s = parent.io.s;
+    io.mmu = &mmu;
+    mem->unmap("io");
+    mem->mapDev("io", 0xC000, 0x100, &io);
+
+    std::size_t n;
+    const uint8_t *rom = parent.mmu.getRom(n);
+    mmu.s = parent.mmu.s;
+    mmu.attach(mem, rom, n);
+
+    std::vector<uint8_t> state;
+    REStateWriter w(state);
+    parent.cpu->save(w);
+    REStateReader r(state);
+    cpu->load(r);
+}
+
+// Main and aux RAM, and bank 1 of each language card, live in blocks that
+// the MMU swaps in page by page; the ROM stays mapped underneath, which
+// keeps it alive and in save states. $C100-$CFFF is plain RAM until there
+// are slot and internal ROMs to put there.
+void AppleIIe::mapMemory(const uint8_t *rom, std::size_t n) {
+    mem->alloc("main", 0x10000);
+    mem->alloc("aux", 0x10000);
+    mem->alloc("main-bank1", 0x1000);
+    mem->alloc("aux-bank1", 0x1000);
+    mem->mapBank("ram", 0x0000, 0xC000);
+    mem->mapMem("cx", 0xC100, 0xF00, true);
+    mem->mapBank("lc", 0xD000, 0x3000);
+    mem->mapDev("io", 0xC000, 0x100, &io);
+
+    io.mmu = &mmu;
+    mmu.attach(mem, rom, n);
+}
+
 AppleIIe::~AppleIIe() {
     // spdlog::debug("AppleIIe::~AppleIIe()");
     delete this->cpu;
+    delete this->mem;
 }
 
 Registers *AppleIIe::getRegs() {
     return cpu->getRegs();
 }
 
+RAM<uint16_t, uint8_t> *AppleIIe::getMem() {
+    return mem;
+}
+
 void AppleIIe::reset() {
+    io.reset();
+    mmu.reset();
     cpu->reset();
 }
 
@@ -40,6 +99,73 @@ void AppleIIe::step() {
     cpu->step();
 }
 
+uint64_t AppleIIe::run(uint64_t n) {
+    return cpu->run(n);
+}
+
+uint64_t AppleIIe::runCycles(uint64_t n) {
+    return cpu->runCycles(n);
+}
+
+uint64_t AppleIIe::getCycles() {
+    return cpu->getCycles();
+}
+
+uint32_t AppleIIe::getClockKHz() {
+    return clk_khz;
+}
+
+void AppleIIe::saveState(std::vector<uint8_t> &out) {
+    REStateWriter w(out);
+    w.header("AppleIIe");
+    cpu->save(w);
+    io.save(w);
+    mmu.save(w);
+    mem->save(w);
+}
+
+bool AppleIIe::loadState(const std::vector<uint8_t> &in) {
+    // Check the whole state before touching anything, so a bad one
+    // leaves the machine as it was
+    for(bool apply : {false, true}) {
+        REStateReader r(in);
+        if(!r.header("AppleIIe")) {
+            spdlog::error("Not an AppleIIe save state");
+            return false;
+        }
+        if(!cpu->load(r, apply) || !io.load(r, apply) || !mmu.load(r, apply) || !mem->load(r, apply))
+            return false;
+    }
+    mmu.update();
+    return true;
+}
+
+std::unique_ptr<REMachine> AppleIIe::fork() {
+    auto image = mem->image();
+    if(!image) return nullptr;
+    return std::unique_ptr<REMachine>(new AppleIIe(*this, image));
+}
+
+void AppleIIe::setRewind(std::size_t budget) {
+    cpu->setRewind(budget);
+}
+
+uint64_t AppleIIe::stepBack(uint64_t n) {
+    return cpu->stepBack(n);
+}
+
+uint64_t AppleIIe::reverseContinue() {
+    return cpu->reverseContinue();
+}
+
+uint64_t AppleIIe::rewindDepth() {
+    return cpu->rewindDepth();
+}
+
+void AppleIIe::key(uint8_t ascii) {
+    io.key(ascii);
+}
+
 void AppleIIe::unload() {
     mem->unmap("test");
 }
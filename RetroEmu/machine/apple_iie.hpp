@@ -4,27 +4,58 @@
 #include <common/ram.hpp>
 #include <common/machine.hpp>
 #include <cpu/6502.hpp>
+#include <machine/apple_iie_io.hpp>
+#include <machine/apple_iie_mmu.hpp>
 
 class AppleIIe : public REMachine {
 public:
     uint32_t clk_khz;
 
     AppleIIe();
+    // Maps a monitor ROM image the caller keeps alive instead of loading
+    // one, so many machines can share it
+    AppleIIe(const uint8_t *rom, std::size_t n);
     ~AppleIIe();
 
     void reset();
     void step();
+    uint64_t run(uint64_t n);
     void print();
 
+    uint64_t runCycles(uint64_t n);
+    uint64_t getCycles();
+    uint32_t getClockKHz();
+
+    void saveState(std::vector<uint8_t> &out);
+    bool loadState(const std::vector<uint8_t> &in);
+    std::unique_ptr<REMachine> fork();
+
+    void setRewind(std::size_t budget);
+    uint64_t stepBack(uint64_t n);
+    uint64_t reverseContinue();
+    uint64_t rewindDepth();
+
     Registers *getRegs();
+    RAM<uint16_t, uint8_t> *getMem();
+    MOS6502 *getCPU() {
+        return cpu;
+    }
     RAM<uint16_t, uint8_t> *mem;
 
     void load(const char *path, uint16_t addr);
     void unload();
 
+    void key(uint8_t ascii);
+    AppleIIeIO io;
+    AppleIIeMMU mmu;
+
 private:
     MOS6502 *cpu;
 
+    void mapMemory(const uint8_t *rom, std::size_t n);
+
+    AppleIIe(const AppleIIe &parent, std::shared_ptr<const RAM<uint16_t, uint8_t>::Image> image);
+
     // uint8_t read_mem(uint16_t);
     // void write_mem(uint16_t, uint8_t);
 };
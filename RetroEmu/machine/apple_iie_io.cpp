@@ -0,0 +1,115 @@
+#include <spdlog/spdlog.h>
+
+#include <machine/apple_iie_io.hpp>
+
+AppleIIeIO::AppleIIeIO() {
+    s = {};
+    s.text = true;
+}
+
+void AppleIIeIO::reset() {
+    bool speaker = s.speaker;
+    uint32_t clicks = s.clicks;
+    s = {};
+    s.text = true;
+    s.speaker = speaker;
+    s.clicks = clicks;
+}
+
+void AppleIIeIO::key(uint8_t ascii) {
+    s.key = ascii & 0x7F;
+    s.strobe = true;
+}
+
+// Value of the switch status reads, and the keyboard; the low seven bits
+// are the keyboard latch on real hardware
+uint8_t AppleIIeIO::status(uint16_t addr) {
+    uint8_t flag;
+    switch(addr & 0xFF) {
+    case 0x1A: flag = s.text; break;
+    case 0x1B: flag = s.mixed; break;
+    case 0x1C: flag = s.page2; break;
+    case 0x1D: flag = s.hires; break;
+    case 0x1E: flag = s.altchar; break;
+    case 0x1F: flag = s.col80; break;
+    case 0x11: case 0x12: case 0x13: case 0x14:
+    case 0x15: case 0x16: case 0x17: case 0x18:
+        flag = mmu && mmu->status(addr);
+        break;
+    default:
+        if((addr & 0xF0) == 0x00) return s.key | (s.strobe ? 0x80 : 0);
+        if((addr & 0xFF) == 0x10) return s.key;
+        return 0;
+    }
+    return (flag ? 0x80 : 0) | s.key;
+}
+
+// Side effects of reads and writes; only writes flip the switches at
+// $C000-$C00F, where reads are the keyboard
+void AppleIIeIO::access(uint16_t addr, bool write) {
+    switch(addr & 0xF0) {
+    case 0x00:
+        if(!write) break;
+        switch(addr & 0x0F) {
+        case 0xC: s.col80 = false; break;
+        case 0xD: s.col80 = true; break;
+        case 0xE: s.altchar = false; break;
+        case 0xF: s.altchar = true; break;
+        default:
+            if(mmu) mmu->write(addr);
+        }
+        break;
+    case 0x10:
+        if((addr & 0xFF) == 0x10) s.strobe = false;
+        break;
+    case 0x30:
+        s.speaker = !s.speaker;
+        s.clicks++;
+        break;
+    case 0x50:
+        switch(addr & 0x0F) {
+        case 0x0: s.text = false; break;
+        case 0x1: s.text = true; break;
+        case 0x2: s.mixed = false; break;
+        case 0x3: s.mixed = true; break;
+        case 0x4: s.page2 = false; break;
+        case 0x5: s.page2 = true; break;
+        case 0x6: s.hires = false; break;
+        case 0x7: s.hires = true; break;
+        }
+        if(mmu) mmu->display(s.page2, s.hires);
+        break;
+    case 0x80:
+        if(mmu) mmu->langCard(addr, write);
+        break;
+    }
+}
+
+uint8_t AppleIIeIO::read(uint16_t addr) {
+    uint8_t data = status(addr);
+    access(addr, false);
+    return data;
+}
+
+// Every switch here acts on the address alone; the data is ignored
+void AppleIIeIO::write(uint16_t addr, uint8_t) {
+    access(addr, true);
+}
+
+uint8_t AppleIIeIO::peek(uint16_t addr) {
+    return status(addr);
+}
+
+void AppleIIeIO::save(REStateWriter &w) {
+    w.put(s);
+}
+
+bool AppleIIeIO::load(REStateReader &r, bool apply) {
+    State saved;
+    if(!r.get(saved)) {
+        spdlog::error("Truncated I/O state");
+        return false;
+    }
+    if(apply) s = saved;
+    return true;
+}
@@ -0,0 +1,48 @@
+#ifndef APPLE_IIE_IO_H
+#define APPLE_IIE_IO_H
+
+#include <cstdint>
+
+#include <common/device.hpp>
+#include <common/state.hpp>
+#include <machine/apple_iie_mmu.hpp>
+
+// The $C000-$C0FF I/O page: keyboard latch, speaker and the display soft
+// switches, passing the memory switches on to the MMU. Anything not
+// decoded here reads as 0 and ignores writes.
+class AppleIIeIO : public REDevice<uint16_t, uint8_t> {
+public:
+    struct State {
+        uint8_t key;      // Last key pressed, high bit clear
+        bool strobe;      // Set by a key press, cleared through $C010
+        bool text;        // $C050/$C051
+        bool mixed;       // $C052/$C053
+        bool page2;       // $C054/$C055
+        bool hires;       // $C056/$C057
+        bool col80;       // $C00C/$C00D
+        bool altchar;     // $C00E/$C00F
+        bool speaker;     // Flips on every $C030 access
+        uint32_t clicks;  // Speaker flips so far
+    } s;
+
+    // Takes the memory switches, if set
+    AppleIIeMMU *mmu = nullptr;
+
+    AppleIIeIO();
+
+    uint8_t read(uint16_t addr);
+    void write(uint16_t addr, uint8_t data);
+    uint8_t peek(uint16_t addr);
+
+    void key(uint8_t ascii);
+    void reset();
+
+    void save(REStateWriter &);
+    bool load(REStateReader &, bool apply = true);
+
+private:
+    uint8_t status(uint16_t addr);
+    void access(uint16_t addr, bool write);
+};
+
+#endif
@@ -0,0 +1,160 @@
+#include <spdlog/spdlog.h>
+
+#include <machine/apple_iie_mmu.hpp>
+
+// What ROM pages the image does not cover read as
+static uint8_t blank[0x100];
+
+AppleIIeMMU::AppleIIeMMU() {
+    reset();
+}
+
+void AppleIIeMMU::attach(RAM<uint16_t, uint8_t> *m, const uint8_t *r, std::size_t n) {
+    mem = m;
+    main = mem->block("main");
+    aux = mem->block("aux");
+    mainBank1 = mem->block("main-bank1");
+    auxBank1 = mem->block("aux-bank1");
+    rom = r;
+    romSize = n;
+
+    // RAM never writes through rd, so the ROM can sit behind it as is
+    for(std::size_t i = 0; i < 0x30; i++) {
+        std::size_t addr = 0xD000 + (i << 8);
+        romPages[i] = addr >= 0x10000 - n ? (uint8_t *)rom + (addr - (0x10000 - n)) : blank;
+    }
+    update();
+}
+
+// Power-on state: main memory everywhere, ROM read with bank 2 RAM
+// write-enabled underneath it
+void AppleIIeMMU::reset() {
+    logState();
+    s = {};
+    s.lcwrite = true;
+    s.lcbank2 = true;
+    update();
+}
+
+void AppleIIeMMU::update() {
+    mapZeroPage();
+    mapMain();
+    mapLangCard();
+}
+
+void AppleIIeMMU::mapZeroPage() {
+    if(!mem) return;
+    uint8_t *zp = s.altzp ? aux : main;
+    for(std::size_t pg = 0x00; pg < 0x02; pg++) {
+        mem->setPage(pg, zp + (pg << 8), zp + (pg << 8));
+    }
+}
+
+void AppleIIeMMU::mapMain() {
+    if(!mem) return;
+    uint8_t *rd = s.ramrd ? aux : main;
+    uint8_t *wr = s.ramwrt ? aux : main;
+    uint8_t *display = s.page2 ? aux : main;
+    for(std::size_t pg = 0x02; pg < 0xC0; pg++) {
+        bool text = pg >= 0x04 && pg < 0x08;
+        bool hires = s.hires && pg >= 0x20 && pg < 0x40;
+        if(s.store80 && (text || hires)) {
+            mem->setPage(pg, display + (pg << 8), display + (pg << 8));
+        } else {
+            mem->setPage(pg, rd + (pg << 8), wr + (pg << 8));
+        }
+    }
+}
+
+// The language card follows ALTZP between main and aux
+void AppleIIeMMU::mapLangCard() {
+    if(!mem) return;
+    uint8_t *ram = s.altzp ? aux : main;
+    uint8_t *bank1 = s.altzp ? auxBank1 : mainBank1;
+    for(std::size_t pg = 0xD0; pg < 0x100; pg++) {
+        uint8_t *p = pg < 0xE0 && !s.lcbank2 ? bank1 + ((pg - 0xD0) << 8) : ram + (pg << 8);
+        mem->setPage(pg, s.lcram ? p : romPages[pg - 0xD0], s.lcwrite ? p : nullptr);
+    }
+}
+
+void AppleIIeMMU::write(uint16_t addr) {
+    bool on = addr & 1;
+    logState();
+    switch(addr & 0x0E) {
+    case 0x00:
+        s.store80 = on;
+        mapMain();
+        break;
+    case 0x02:
+        s.ramrd = on;
+        mapMain();
+        break;
+    case 0x04:
+        s.ramwrt = on;
+        mapMain();
+        break;
+    case 0x06:
+        s.intcxrom = on; // No internal $Cx ROM to switch to yet
+        break;
+    case 0x08:
+        s.altzp = on;
+        mapZeroPage();
+        mapLangCard();
+        break;
+    case 0x0A:
+        s.slotc3rom = on;
+        break;
+    }
+}
+
+// Bit 3 picks the bank; bits 0 and 1 pick RAM or ROM to read, and whether
+// to write-enable, which takes two reads of an odd switch in a row
+void AppleIIeMMU::langCard(uint16_t addr, bool write) {
+    logState();
+    s.lcbank2 = !(addr & 0x08);
+    s.lcram = (addr & 0x03) == 0x00 || (addr & 0x03) == 0x03;
+    if(addr & 0x01) {
+        if(!write && s.prewrite) s.lcwrite = true;
+        s.prewrite = !write;
+    } else {
+        s.lcwrite = false;
+        s.prewrite = false;
+    }
+    mapLangCard();
+}
+
+void AppleIIeMMU::display(bool page2, bool hires) {
+    if(page2 == s.page2 && hires == s.hires) return;
+    logState();
+    s.page2 = page2;
+    s.hires = hires;
+    if(s.store80) mapMain();
+}
+
+bool AppleIIeMMU::status(uint16_t addr) {
+    switch(addr & 0xFF) {
+    case 0x11: return s.lcbank2;
+    case 0x12: return s.lcram;
+    case 0x13: return s.ramrd;
+    case 0x14: return s.ramwrt;
+    case 0x15: return s.intcxrom;
+    case 0x16: return s.altzp;
+    case 0x17: return s.slotc3rom;
+    case 0x18: return s.store80;
+    }
+    return false;
+}
+
+void AppleIIeMMU::save(REStateWriter &w) {
+    w.put(s);
+}
+
+bool AppleIIeMMU::load(REStateReader &r, bool apply) {
+    State saved;
+    if(!r.get(saved)) {
+        spdlog::error("Truncated memory switch state");
+        return false;
+    }
+    if(apply) s = saved;
+    return true;
+}
@@ -0,0 +1,79 @@
+#ifndef APPLE_IIE_MMU_H
+#define APPLE_IIE_MMU_H
+
+#include <cstdint>
+
+#include <common/ram.hpp>
+#include <common/state.hpp>
+
+// Auxiliary memory and the language card: which of main or aux RAM, and
+// which language card bank or the ROM, each page of the address space
+// reaches. A switch only repoints the pages it affects in the RAM's page
+// table, so plain reads and writes never see it.
+//
+// The machine maps $0000-$BFFF and $D000-$FFFF as banks and allocates the
+// blocks behind them; the switches themselves arrive through the I/O page.
+class AppleIIeMMU {
+public:
+    struct State {
+        bool store80;   // $C000/$C001: PAGE2 picks main or aux display pages
+        bool ramrd;     // $C002/$C003: read aux at $0200-$BFFF
+        bool ramwrt;    // $C004/$C005: write aux at $0200-$BFFF
+        bool intcxrom;  // $C006/$C007
+        bool altzp;     // $C008/$C009: aux zero page, stack and language card
+        bool slotc3rom; // $C00A/$C00B
+        bool lcram;     // Read language card RAM rather than ROM
+        bool lcwrite;   // Write language card RAM
+        bool lcbank2;   // $D000-$DFFF from bank 2
+        bool prewrite;  // First of the two reads that write-enable
+        bool page2;     // Display switches, mirrored for 80STORE
+        bool hires;
+    } s;
+
+    AppleIIeMMU();
+
+    // Finds the blocks in mem and points the banks at them. The ROM covers
+    // the top n bytes of the address space; the caller keeps it alive.
+    void attach(RAM<uint16_t, uint8_t> *mem, const uint8_t *rom, std::size_t n);
+    void reset();
+
+    // Writes to $C000-$C00B
+    void write(uint16_t addr);
+    // Any access to $C080-$C08F
+    void langCard(uint16_t addr, bool write);
+    void display(bool page2, bool hires);
+    // Status reads at $C011-$C018
+    bool status(uint16_t addr);
+
+    void save(REStateWriter &);
+    bool load(REStateReader &, bool apply = true);
+    // Repoints every bank, after loading state
+    void update();
+
+    const uint8_t *getRom(std::size_t &n) const {
+        n = romSize;
+        return rom;
+    }
+
+private:
+    RAM<uint16_t, uint8_t> *mem = nullptr;
+    uint8_t *main = nullptr;
+    uint8_t *aux = nullptr;
+    uint8_t *mainBank1 = nullptr;
+    uint8_t *auxBank1 = nullptr;
+    const uint8_t *rom = nullptr;
+    std::size_t romSize = 0;
+    uint8_t *romPages[0x30]; // $D000-$FFFF
+
+    // Before every change to s, so rewinding over a switch takes it back
+    // along with the pages it moved
+    void logState() {
+        if(mem) mem->logHost((uint8_t *)&s, sizeof(s));
+    }
+
+    void mapZeroPage();
+    void mapMain();
+    void mapLangCard();
+};
+
+#endif
@@ -0,0 +1,217 @@
+#include <algorithm>
+
+#include <machine/apple_iie_video.hpp>
+
+// Pixels in memory order, R G B A, as GL_RGBA/GL_UNSIGNED_BYTE wants them
+static constexpr uint32_t rgb(uint8_t r, uint8_t g, uint8_t b) {
+    return r | (g << 8) | (b << 16) | 0xFF000000;
+}
+
+static const uint32_t palette[16] = {
+    rgb(0x00, 0x00, 0x00), // Black
+    rgb(0x99, 0x03, 0x5F), // Magenta
+    rgb(0x42, 0x04, 0xE1), // Dark blue
+    rgb(0xCA, 0x13, 0xFE), // Purple
+    rgb(0x00, 0x73, 0x10), // Dark green
+    rgb(0x7F, 0x7F, 0x7F), // Grey
+    rgb(0x24, 0x97, 0xFF), // Medium blue
+    rgb(0xAA, 0xA2, 0xFF), // Light blue
+    rgb(0x4F, 0x51, 0x01), // Brown
+    rgb(0xF0, 0x5C, 0x00), // Orange
+    rgb(0xBE, 0xBE, 0xBE), // Grey
+    rgb(0xFF, 0x85, 0xE1), // Pink
+    rgb(0x12, 0xCA, 0x07), // Light green
+    rgb(0xCE, 0xD4, 0x13), // Yellow
+    rgb(0x51, 0xF5, 0x95), // Aqua
+    rgb(0xFF, 0xFF, 0xFF), // White
+};
+
+static const uint32_t BLACK = palette[0];
+static const uint32_t WHITE = palette[15];
+
+// Hires colours of a lone pixel, by palette bit and column parity
+static const uint32_t hiresColours[2][2] = {
+    {palette[3], palette[12]}, // Violet, green
+    {palette[6], palette[9]},  // Blue, orange
+};
+
+// 5x7 glyphs for $20-$5F, top row first, bit 4 leftmost. There is no
+// character ROM to read them from, so lowercase shows as uppercase.
+static const uint8_t font[64][7] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Space
+    {0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04}, // !
+    {0x0A, 0x0A, 0x0A, 0x00, 0x00, 0x00, 0x00}, // "
+    {0x0A, 0x0A, 0x1F, 0x0A, 0x1F, 0x0A, 0x0A}, // #
+    {0x04, 0x0F, 0x14, 0x0E, 0x05, 0x1E, 0x04}, // $
+    {0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03}, // %
+    {0x08, 0x14, 0x14, 0x08, 0x15, 0x12, 0x0D}, // &
+    {0x04, 0x04, 0x04, 0x00, 0x00, 0x00, 0x00}, // '
+    {0x04, 0x08, 0x10, 0x10, 0x10, 0x08, 0x04}, // (
+    {0x04, 0x02, 0x01, 0x01, 0x01, 0x02, 0x04}, // )
+    {0x04, 0x15, 0x0E, 0x04, 0x0E, 0x15, 0x04}, // *
+    {0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00}, // +
+    {0x00, 0x00, 0x00, 0x00, 0x04, 0x04, 0x08}, // ,
+    {0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00}, // -
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04}, // .
+    {0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00}, // /
+    {0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E}, // 0
+    {0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E}, // 1
+    {0x0E, 0x11, 0x01, 0x06, 0x08, 0x10, 0x1F}, // 2
+    {0x1F, 0x01, 0x02, 0x06, 0x01, 0x11, 0x0E}, // 3
+    {0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02}, // 4
+    {0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E}, // 5
+    {0x07, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E}, // 6
+    {0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}, // 7
+    {0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E}, // 8
+    {0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x1C}, // 9
+    {0x00, 0x00, 0x04, 0x00, 0x04, 0x00, 0x00}, // :
+    {0x00, 0x00, 0x04, 0x00, 0x04, 0x04, 0x08}, // ;
+    {0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02}, // <
+    {0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00}, // =
+    {0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08}, // >
+    {0x0E, 0x11, 0x02, 0x04, 0x04, 0x00, 0x04}, // ?
+    {0x0E, 0x11, 0x15, 0x17, 0x16, 0x10, 0x0F}, // @
+    {0x04, 0x0A, 0x11, 0x11, 0x1F, 0x11, 0x11}, // A
+    {0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E}, // B
+    {0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E}, // C
+    {0x1E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x1E}, // D
+    {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F}, // E
+    {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10}, // F
+    {0x0F, 0x10, 0x10, 0x13, 0x11, 0x11, 0x0F}, // G
+    {0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}, // H
+    {0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E}, // I
+    {0x01, 0x01, 0x01, 0x01, 0x01, 0x11, 0x0E}, // J
+    {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11}, // K
+    {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F}, // L
+    {0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11}, // M
+    {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11}, // N
+    {0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}, // O
+    {0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10}, // P
+    {0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D}, // Q
+    {0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11}, // R
+    {0x0E, 0x11, 0x10, 0x0E, 0x01, 0x11, 0x0E}, // S
+    {0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}, // T
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}, // U
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04}, // V
+    {0x11, 0x11, 0x11, 0x15, 0x15, 0x1B, 0x11}, // W
+    {0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11}, // X
+    {0x11, 0x11, 0x0A, 0x04, 0x04, 0x04, 0x04}, // Y
+    {0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F}, // Z
+    {0x1F, 0x18, 0x18, 0x18, 0x18, 0x18, 0x1F}, // [
+    {0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00}, // Backslash
+    {0x1F, 0x03, 0x03, 0x03, 0x03, 0x03, 0x1F}, // ]
+    {0x00, 0x00, 0x04, 0x0A, 0x11, 0x00, 0x00}, // ^
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F}, // _
+};
+
+// Text and lores rows, and hires lines, are interleaved in memory
+static uint16_t rowAddr(int row) {
+    return (row & 7) * 0x80 + (row >> 3) * 0x28;
+}
+
+static uint16_t hiresAddr(int y) {
+    return (y & 7) * 0x400 + ((y >> 3) & 7) * 0x80 + (y >> 6) * 0x28;
+}
+
+AppleIIeVideo::Mode AppleIIeVideo::mode(const AppleIIeIO::State &io, const AppleIIeMMU::State &mmu, bool flash) {
+    return {io.text, io.mixed, io.hires, io.page2 && !mmu.store80, flash};
+}
+
+AppleIIeVideo::AppleIIeVideo() {
+    image = std::vector<uint32_t>(WIDTH * HEIGHT, BLACK);
+    lineVersions = std::vector<uint32_t>(HEIGHT, 0);
+    last = {};
+
+    hiresTable = std::vector<uint32_t>(2048 * 7);
+    for(int i = 0; i < 2048; i++) {
+        int byte = i & 0xFF;
+        int parity = (i >> 8) & 1;
+        int next = (i >> 9) & 1;
+        int prev = (i >> 10) & 1;
+        for(int x = 0; x < 7; x++) {
+            int on = (byte >> x) & 1;
+            int left = x ? (byte >> (x - 1)) & 1 : prev;
+            int right = x < 6 ? (byte >> (x + 1)) & 1 : next;
+            uint32_t colour = hiresColours[byte >> 7][(parity + x) & 1];
+            hiresTable[i * 7 + x] = !on ? BLACK : (left || right) ? WHITE : colour;
+        }
+    }
+}
+
+bool AppleIIeVideo::update(const uint8_t *mem, const uint32_t *versions, Mode mode, int &top, int &bottom) {
+    // Flashing only shows where there is text
+    if(!mode.text && !mode.mixed) mode.flash = false;
+    bool redraw = !drawn || !(mode == last);
+
+    uint16_t textBase = mode.page2 ? 0x0800 : 0x0400;
+    uint16_t hiresBase = mode.page2 ? 0x4000 : 0x2000;
+
+    top = HEIGHT;
+    bottom = 0;
+    for(int y = 0; y < HEIGHT; y++) {
+        bool text = mode.text || (mode.mixed && y >= 160);
+        uint16_t addr = !text && mode.hires ? hiresBase + hiresAddr(y) : textBase + rowAddr(y >> 3);
+
+        uint32_t v = versions[addr >> 8];
+        if(!redraw && lineVersions[y] == v) continue;
+        lineVersions[y] = v;
+
+        uint32_t *out = &image[y * WIDTH];
+        if(text) {
+            drawText(mem + addr, out, y & 7, mode.flash);
+        } else if(mode.hires) {
+            drawHires(mem + addr, out);
+        } else {
+            drawLores(mem + addr, out, (y & 7) >> 2);
+        }
+
+        top = std::min(top, y);
+        bottom = y + 1;
+    }
+
+    drawn = true;
+    last = mode;
+    return top < bottom;
+}
+
+// Characters below $40 are inverse, $40-$7F flash, the rest are normal.
+// In each run of 64 the first 32 are letters and the rest symbols, except
+// that $60-$7F and $E0-$FF are lowercase, drawn with the letters.
+void AppleIIeVideo::drawText(const uint8_t *row, uint32_t *out, int line, bool flash) {
+    for(int col = 0; col < 40; col++) {
+        uint8_t c = row[col];
+        int glyph = (c & 0x1F) | ((c & 0x60) == 0x20 ? 0x00 : 0x20);
+        uint8_t bits = line < 7 ? font[glyph][line] : 0;
+        bool inverse = c < 0x40 || (c < 0x80 && flash);
+        uint32_t fg = inverse ? BLACK : WHITE;
+        uint32_t bg = inverse ? WHITE : BLACK;
+
+        out[0] = bg;
+        for(int x = 0; x < 5; x++) {
+            out[1 + x] = (bits >> (4 - x)) & 1 ? fg : bg;
+        }
+        out[6] = bg;
+        out += 7;
+    }
+}
+
+// Each byte is two blocks, the low nibble above the high one
+void AppleIIeVideo::drawLores(const uint8_t *row, uint32_t *out, int half) {
+    for(int col = 0; col < 40; col++) {
+        uint32_t colour = palette[(row[col] >> (half * 4)) & 0x0F];
+        std::fill(out, out + 7, colour);
+        out += 7;
+    }
+}
+
+void AppleIIeVideo::drawHires(const uint8_t *line, uint32_t *out) {
+    int prev = 0;
+    for(int col = 0; col < 40; col++) {
+        uint8_t byte = line[col];
+        int next = col < 39 ? line[col + 1] & 1 : 0;
+        const uint32_t *px = &hiresTable[((prev << 10) | (next << 9) | ((col & 1) << 8) | byte) * 7];
+        std::copy(px, px + 7, out);
+        prev = (byte >> 6) & 1;
+        out += 7;
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef APPLE_IIE_VIDEO_H
+#define APPLE_IIE_VIDEO_H
+
+#include <cstdint>
+#include <vector>
+
+#include <machine/apple_iie_io.hpp>
+#include <machine/apple_iie_mmu.hpp>
+
+// Draws the 40-column text, lores and hires screens into a WIDTH x HEIGHT
+// RGBA image. It works from main memory, which is what the screen shows
+// whatever RAMRD or 80STORE let the CPU see, and the RAM's page versions,
+// and only redraws the lines whose page version or mode changed since the
+// last update.
+//
+// Hires colour is the usual approximation: two lit pixels in a row are
+// white, a lone one takes its colour from the column and the palette bit.
+// Each byte is decoded through a table indexed by its neighbours' edge
+// pixels, so a line is 40 lookups.
+class AppleIIeVideo {
+public:
+    static constexpr int WIDTH = 280;
+    static constexpr int HEIGHT = 192;
+
+    struct Mode {
+        bool text;
+        bool mixed;
+        bool hires;
+        bool page2; // Only shows page 2 with 80STORE off
+        bool flash; // Phase of flashing characters
+
+        bool operator==(const Mode &) const = default;
+    };
+
+    static Mode mode(const AppleIIeIO::State &io, const AppleIIeMMU::State &mmu, bool flash);
+
+    AppleIIeVideo();
+
+    // Redraws what changed and returns whether anything did, with the
+    // lines redrawn in [top, bottom). mem is the 64K main block, not the
+    // address space.
+    bool update(const uint8_t *mem, const uint32_t *versions, Mode mode, int &top, int &bottom);
+
+    const uint32_t *pixels() const {
+        return image.data();
+    }
+
+private:
+    std::vector<uint32_t> image;
+    std::vector<uint32_t> lineVersions; // Page version each line was drawn from
+    Mode last;
+    bool drawn = false;
+
+    // Seven pixels for every byte, by previous pixel, next pixel and
+    // column parity
+    std::vector<uint32_t> hiresTable;
+
+    void drawText(const uint8_t *row, uint32_t *out, int line, bool flash);
+    void drawLores(const uint8_t *row, uint32_t *out, int half);
+    void drawHires(const uint8_t *line, uint32_t *out);
+};
+
+#endif
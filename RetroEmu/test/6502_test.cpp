@@ -0,0 +1,298 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include <common/ram.hpp>
+#include <cpu/6502.hpp>
+#include <cpu/6502_opcodes.hpp>
+
+#include "json.hpp"
+
+// Checks the interpreter cores against outside references:
+//
+//  - Single-step vectors, one JSON file per opcode ("00.json" to
+//    "ff.json"), each an array of cases giving the registers and RAM
+//    before and after one instruction and the bus cycles it took.
+//    test/data/6502 holds a few cases for some opcodes, run as InTree/*.
+//  - The full corpora, run as Corpus/* and only listed when named:
+//    $RETROEMU_6502_VECTORS, a directory such as SingleStepTests' 6502/v1
+//    with a file for every documented opcode, and $RETROEMU_KLAUS_BIN,
+//    Klaus Dormann's 6502 functional test. CMake passes them on from the
+//    cache variables of the same names as the "corpus" labelled test.
+//
+// Every opcode and core is a test of its own, so "ctest -j" runs them
+// across all cores. A named file that is missing fails.
+//
+// The switch core has no decimal mode, so it leaves out ADC and SBC cases
+// with D set, and the functional test unless $RETROEMU_KLAUS_DECIMAL is 0
+// to say the binary was assembled without its decimal tests.
+
+static const MOS6502::Core CORES[] = {MOS6502::CORE_SWITCH, MOS6502::CORE_TABLE, MOS6502::CORE_TRACE};
+
+static const char *coreName(MOS6502::Core core) {
+    return core == MOS6502::CORE_TRACE ? "Trace" : core == MOS6502::CORE_TABLE ? "Table" : "Switch";
+}
+
+// An environment variable that is set to something
+static const char *corpus(const char *env) {
+    const char *path = getenv(env);
+    return path && *path ? path : nullptr;
+}
+
+static bool documented(int opcode) {
+    return strcmp(MOS6502_OPCODES[opcode].mnemonic, "???") != 0;
+}
+
+static std::vector<int> documentedOpcodes() {
+    std::vector<int> opcodes;
+    for(int opcode = 0; opcode < 0x100; opcode++) {
+        if(documented(opcode)) opcodes.push_back(opcode);
+    }
+    return opcodes;
+}
+
+static std::string vectorPath(const std::string &dir, int opcode) {
+    char name[8];
+    snprintf(name, sizeof(name), "%02x.json", opcode);
+    return dir + "/" + name;
+}
+
+// Whether this core gets the case's arithmetic wrong by design
+static bool decimalSkipped(MOS6502::Core core, int opcode, uint32_t p) {
+    const char *mnemonic = MOS6502_OPCODES[opcode].mnemonic;
+    return core == MOS6502::CORE_SWITCH && (p & 0x08) && (!strcmp(mnemonic, "ADC") || !strcmp(mnemonic, "SBC"));
+}
+
+// B and bit 5 only exist on the stack
+static constexpr uint8_t FLAGS_MASK = (uint8_t)~0x30;
+
+struct Machine {
+    RAM<uint16_t, uint8_t> mem;
+    MOS6502 cpu;
+    Registers &regs;
+
+    Machine(MOS6502::Core core) : cpu(&mem, core), regs(*cpu.getRegs()) {
+        mem.mapMem("ram", 0, 0x10000, true);
+        cpu.step(); // Out of reset, so the registers set next stay set
+    }
+
+    uint32_t reg(const char *name) {
+        return regs[name]->get();
+    }
+};
+
+// Core, opcode and the directory holding its file
+class SingleStep : public testing::TestWithParam<std::tuple<MOS6502::Core, int, std::string>> {};
+
+// Every core on the opcodes in dir; with all of them, a missing file is
+// a failure rather than one fewer test
+static std::vector<SingleStep::ParamType> vectors(const char *dir, bool all) {
+    std::vector<SingleStep::ParamType> params;
+    if(!dir) return params;
+    for(int opcode : documentedOpcodes()) {
+        if(!all && !std::ifstream(vectorPath(dir, opcode)).good()) continue;
+        for(MOS6502::Core core : CORES) params.emplace_back(core, opcode, dir);
+    }
+    return params;
+}
+
+// Runs every case in one opcode's file, stopping at the first that
+// differs: later ones tend to fail the same way
+TEST_P(SingleStep, Opcode) {
+    auto [core, opcode, dir] = GetParam();
+    std::string path = vectorPath(dir, opcode);
+
+    TestJSON cases;
+    ASSERT_TRUE(std::ifstream(path).good()) << "no vectors at " << path;
+    ASSERT_TRUE(TestJSON::load(path, cases)) << "cannot parse " << path;
+
+    Machine m(core);
+    int skipped = 0;
+    for(std::size_t i = 0; i < cases.size(); i++) {
+        const TestJSON &c = cases[i];
+        const TestJSON &in = c["initial"];
+        const TestJSON &out = c["final"];
+        if(decimalSkipped(core, opcode, in["p"].u32())) {
+            skipped++;
+            continue;
+        }
+
+        m.regs["PC"]->set(in["pc"].u32());
+        m.regs["SP"]->set(in["s"].u32());
+        m.regs["FLAGS"]->set(in["p"].u32());
+        m.regs["A"]->set(in["a"].u32());
+        m.regs["X"]->set(in["x"].u32());
+        m.regs["Y"]->set(in["y"].u32());
+        for(std::size_t j = 0; j < in["ram"].size(); j++) m.mem.write(in["ram"][j][0].u32(), in["ram"][j][1].u32());
+
+        uint64_t start = m.cpu.getCycles();
+        m.cpu.run(1);
+        uint64_t cycles = m.cpu.getCycles() - start;
+
+        std::string diff;
+        auto check = [&](const char *what, uint32_t got, uint32_t want) {
+            if(got == want) return;
+            char line[64];
+            snprintf(line, sizeof(line), "\n  %s: got %X, want %X", what, got, want);
+            diff += line;
+        };
+        check("PC", m.reg("PC"), out["pc"].u32());
+        check("SP", m.reg("SP") & 0xFF, out["s"].u32());
+        check("P", m.reg("FLAGS") & FLAGS_MASK, out["p"].u32() & FLAGS_MASK);
+        check("A", m.reg("A"), out["a"].u32());
+        check("X", m.reg("X"), out["x"].u32());
+        check("Y", m.reg("Y"), out["y"].u32());
+        check("cycles", cycles, c["cycles"].size());
+        for(std::size_t j = 0; j < out["ram"].size(); j++) {
+            uint16_t addr = out["ram"][j][0].u32();
+            char what[16];
+            snprintf(what, sizeof(what), "[%04X]", addr);
+            check(what, m.mem.peek(addr), out["ram"][j][1].u32());
+        }
+
+        if(!diff.empty()) {
+            FAIL() << coreName(core) << " core, case " << i << " \"" << c["name"].string << "\" of " << path << " (A="
+                   << std::hex << in["a"].u32() << " X=" << in["x"].u32() << " Y=" << in["y"].u32() << " P="
+                   << in["p"].u32() << ")" << diff;
+        }
+
+        // Leave nothing behind for the next case to read
+        for(std::size_t j = 0; j < out["ram"].size(); j++) m.mem.write(out["ram"][j][0].u32(), 0);
+    }
+    RecordProperty("cases", (int)cases.size() - skipped);
+    if(skipped) RecordProperty("skipped", skipped);
+    if(skipped == (int)cases.size()) GTEST_SKIP() << "every case is in decimal mode, which this core lacks";
+}
+
+static std::string singleStepName(const testing::TestParamInfo<SingleStep::ParamType> &info) {
+    char name[16];
+    snprintf(name, sizeof(name), "%s_%02X", coreName(std::get<0>(info.param)), std::get<1>(info.param));
+    return std::string(name);
+}
+
+INSTANTIATE_TEST_SUITE_P(InTree, SingleStep, testing::ValuesIn(vectors(RETROEMU_TEST_DATA "/6502", false)),
+    singleStepName);
+INSTANTIATE_TEST_SUITE_P(Corpus, SingleStep, testing::ValuesIn(vectors(corpus("RETROEMU_6502_VECTORS"), true)),
+    singleStepName);
+
+class Differential : public testing::TestWithParam<int> {};
+
+// The switch core against the table core from random states, with D clear
+// as only the table core has decimal mode. The operand bytes and zero page
+// change every case, so pointers, indexing and branches land all over.
+TEST_P(Differential, SwitchMatchesTable) {
+    int opcode = GetParam();
+    std::mt19937 rng(opcode);
+    std::vector<uint8_t> image(0x10000), sw(0x10000), table(0x10000);
+    for(auto &b : image) b = rng();
+
+    RAM<uint16_t, uint8_t> swMem, tableMem;
+    swMem.mapBuf("ram", 0, sw.size(), sw.data(), true);
+    tableMem.mapBuf("ram", 0, table.size(), table.data(), true);
+    MOS6502 swCpu(&swMem, MOS6502::CORE_SWITCH), tableCpu(&tableMem, MOS6502::CORE_TABLE);
+    swCpu.step();
+    tableCpu.step();
+    Registers &swRegs = *swCpu.getRegs(), &tableRegs = *tableCpu.getRegs();
+    const char *names[] = {"PC", "A", "X", "Y", "SP", "FLAGS"};
+
+    for(int i = 0; i < 200; i++) {
+        uint16_t pc = rng();
+        image[pc] = opcode;
+        image[(uint16_t)(pc + 1)] = rng();
+        image[(uint16_t)(pc + 2)] = rng();
+        for(int j = 0; j < 0x100; j++) image[j] = rng();
+        memcpy(sw.data(), image.data(), image.size());
+        memcpy(table.data(), image.data(), image.size());
+
+        uint32_t in[] = {pc, (uint32_t)rng() & 0xFF, (uint32_t)rng() & 0xFF, (uint32_t)rng() & 0xFF,
+                         (uint32_t)rng() & 0xFF, (uint32_t)rng() & 0xF7};
+        for(int j = 0; j < 6; j++) {
+            swRegs[names[j]]->set(in[j]);
+            tableRegs[names[j]]->set(in[j]);
+        }
+
+        uint64_t swStart = swCpu.getCycles(), tableStart = tableCpu.getCycles();
+        swCpu.run(1);
+        tableCpu.run(1);
+
+        std::string diff;
+        for(const char *name : names) {
+            uint32_t mask = strcmp(name, "FLAGS") ? 0xFFFF : FLAGS_MASK;
+            uint32_t got = swRegs[name]->get() & mask, want = tableRegs[name]->get() & mask;
+            if(got != want) diff += std::string("\n  ") + name + ": " + std::to_string(got) + " vs " + std::to_string(want);
+        }
+        if(swCpu.getCycles() - swStart != tableCpu.getCycles() - tableStart) diff += "\n  cycles";
+        if(memcmp(sw.data(), table.data(), sw.size())) diff += "\n  memory";
+        if(!diff.empty()) {
+            FAIL() << "case " << i << " (PC=" << std::hex << in[0] << " A=" << in[1] << " X=" << in[2] << " Y=" << in[3]
+                   << " SP=" << in[4] << " P=" << in[5] << "), switch vs table:" << diff;
+        }
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(MOS6502, Differential, testing::ValuesIn(documentedOpcodes()), [](const testing::TestParamInfo<int> &info) {
+    char name[8];
+    snprintf(name, sizeof(name), "%02X", info.param);
+    return std::string(name);
+});
+
+class Functional : public testing::TestWithParam<MOS6502::Core> {};
+
+// None without a binary, and the switch core only without decimal tests
+static std::vector<MOS6502::Core> functionalCores() {
+    std::vector<MOS6502::Core> cores;
+    if(!corpus("RETROEMU_KLAUS_BIN")) return cores;
+    const char *decimal = getenv("RETROEMU_KLAUS_DECIMAL");
+    for(MOS6502::Core core : CORES) {
+        if(core != MOS6502::CORE_SWITCH || (decimal && !strcmp(decimal, "0"))) cores.push_back(core);
+    }
+    return cores;
+}
+
+// The test loads at 0 and starts at $0400. It ends in a jump or branch
+// to itself: at its success address when everything passed, otherwise
+// at the check that failed, with the test number at $0200.
+TEST_P(Functional, Klaus) {
+    std::string path = corpus("RETROEMU_KLAUS_BIN");
+    std::ifstream file(path, std::ios::binary);
+    ASSERT_TRUE(file.good()) << "no test binary at " << path;
+    std::vector<char> image((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    ASSERT_EQ(image.size(), 0x10000u) << path << " is not a full 64K image";
+
+    const char *env = getenv("RETROEMU_KLAUS_SUCCESS");
+    uint16_t success = env ? strtoul(env, nullptr, 0) : 0x3469;
+
+    Machine m(GetParam());
+    for(uint32_t addr = 0; addr < 0x10000; addr++) m.mem.write(addr, image[addr]);
+    m.regs["PC"]->set(0x0400);
+
+    // Runs in chunks, then one instruction at a time to see whether it
+    // has settled into a trap
+    const uint64_t limit = 200000000;
+    uint64_t ran = 0;
+    uint16_t pc;
+    while(true) {
+        m.cpu.run(100000);
+        ran += 100000;
+        pc = m.reg("PC");
+        m.cpu.run(1);
+        if(m.reg("PC") == pc) break;
+        ASSERT_LT(ran, limit) << "still running at PC " << std::hex << pc;
+    }
+
+    EXPECT_EQ(pc, success) << coreName(GetParam()) << " core trapped at PC " << std::hex << pc << " in test "
+                           << (int)m.mem.peek(0x0200) << " (A=" << m.reg("A") << " X=" << m.reg("X") << " Y="
+                           << m.reg("Y") << " SP=" << m.reg("SP") << " P=" << m.reg("FLAGS") << ")";
+    RecordProperty("cycles", std::to_string(m.cpu.getCycles()));
+}
+
+GTEST_ALLOW_UNINSTANTIATED_PARAMETERIZED_TEST(Functional);
+INSTANTIATE_TEST_SUITE_P(Corpus, Functional, testing::ValuesIn(functionalCores()),
+    [](const testing::TestParamInfo<MOS6502::Core> &info) { return std::string(coreName(info.param)); });
@@ -0,0 +1,190 @@
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include <common/batch.hpp>
+#include <machine/apple_iie.hpp>
+#include <machine/apple_iie_video.hpp>
+#include <test/programs.hpp>
+
+// Machine-level checks that need the MMU and I/O page, run on small
+// programs in a stand-in monitor ROM rather than a real one, and the
+// display drawn from hand-made memory.
+
+// Writes $0300 in main memory, then in aux with RAMRD and RAMWRT on, then
+// in main again once they are off; stepping back over each switch has to
+// put the pages, the switches and both copies of $0300 back as they were.
+TEST(AppleIIe, RewindOverBankSwitch) {
+    std::vector<uint8_t> image = monitorRom({
+        0xA9, 0x11,       // F800 LDA #$11
+        0x8D, 0x00, 0x03, // F802 STA $0300
+        0x8D, 0x03, 0xC0, // F805 STA $C003  RAMRD on
+        0x8D, 0x05, 0xC0, // F808 STA $C005  RAMWRT on
+        0xA9, 0x22,       // F80B LDA #$22
+        0x8D, 0x00, 0x03, // F80D STA $0300
+        0x8D, 0x04, 0xC0, // F810 STA $C004  RAMWRT off
+        0x8D, 0x02, 0xC0, // F813 STA $C002  RAMRD off
+        0xA9, 0x33,       // F816 LDA #$33
+        0x8D, 0x00, 0x03, // F818 STA $0300
+        0x4C, 0x1B, 0xF8, // F81B JMP $F81B
+    });
+    AppleIIe m(image.data(), image.size());
+    m.setRewind(1 << 20);
+    m.step(); // Reset sequence
+
+    uint8_t *main = m.mem->block("main");
+    uint8_t *aux = m.mem->block("aux");
+    Register *pc = (*m.getRegs())["PC"];
+
+    for(int i = 0; i < 10; i++) m.step();
+    ASSERT_EQ(pc->get(), 0xF81B);
+    EXPECT_EQ(main[0x300], 0x33);
+    EXPECT_EQ(aux[0x300], 0x22);
+    EXPECT_FALSE(m.mmu.s.ramrd);
+
+    // Over RAMRD off: reads come from aux again
+    ASSERT_EQ(m.stepBack(3), 3u);
+    EXPECT_EQ(pc->get(), 0xF813);
+    EXPECT_TRUE(m.mmu.s.ramrd);
+    EXPECT_FALSE(m.mmu.s.ramwrt);
+    EXPECT_EQ(main[0x300], 0x11);
+    EXPECT_EQ(aux[0x300], 0x22);
+    EXPECT_EQ(m.mem->peek(0x300), 0x22);
+
+    // Over the aux write and RAMWRT on
+    ASSERT_EQ(m.stepBack(4), 4u);
+    EXPECT_EQ(pc->get(), 0xF808);
+    EXPECT_TRUE(m.mmu.s.ramrd);
+    EXPECT_FALSE(m.mmu.s.ramwrt);
+    EXPECT_EQ(aux[0x300], 0x00);
+    EXPECT_EQ(m.mem->peek(0x300), 0x00);
+
+    // Over RAMRD on, to before anything was written
+    ASSERT_EQ(m.stepBack(3), 3u);
+    EXPECT_EQ(pc->get(), 0xF800);
+    EXPECT_FALSE(m.mmu.s.ramrd);
+    EXPECT_EQ(main[0x300], 0x00);
+    EXPECT_EQ(aux[0x300], 0x00);
+
+    // Back through reset as well, then forward again to the same place
+    m.stepBack(m.rewindDepth());
+    for(int i = 0; i < 11; i++) m.step();
+    EXPECT_EQ(pc->get(), 0xF81B);
+    EXPECT_EQ(main[0x300], 0x33);
+    EXPECT_EQ(aux[0x300], 0x22);
+    EXPECT_EQ(m.mem->peek(0x300), 0x33);
+}
+
+// Counts X up to 5, storing each count to $0300, then finds its way back
+// to earlier stores and to a breakpoint set only afterwards
+TEST(AppleIIe, ReverseContinue) {
+    std::vector<uint8_t> image = monitorRom({
+        0xA2, 0x00,       // F800 LDX #$00
+        0xE8,             // F802 INX
+        0x8E, 0x00, 0x03, // F803 STX $0300
+        0xE0, 0x05,       // F806 CPX #$05
+        0xD0, 0xF8,       // F808 BNE $F802
+        0x4C, 0x0A, 0xF8, // F80A JMP $F80A
+    });
+    AppleIIe m(image.data(), image.size());
+    m.setRewind(1 << 20);
+    Register *pc = (*m.getRegs())["PC"];
+    Register *x = (*m.getRegs())["X"];
+
+    for(int i = 0; i < 25; i++) m.step();
+    ASSERT_EQ(pc->get(), 0xF80A);
+
+    // Stops just after the store that hit, last one first
+    m.mem->watch(0x0300, 1, RAM<uint16_t, uint8_t>::WATCH_WRITE);
+    EXPECT_GT(m.reverseContinue(), 0u);
+    EXPECT_EQ(pc->get(), 0xF806);
+    EXPECT_EQ(m.mem->peek(0x0300), 5);
+    m.reverseContinue();
+    EXPECT_EQ(pc->get(), 0xF806);
+    EXPECT_EQ(x->get(), 4);
+    EXPECT_EQ(m.mem->peek(0x0300), 4);
+
+    // A breakpoint stops before its instruction, the time round before
+    m.mem->watch(0xF808, 1, RAM<uint16_t, uint8_t>::WATCH_EXEC);
+    m.reverseContinue();
+    EXPECT_EQ(pc->get(), 0xF808);
+    EXPECT_EQ(x->get(), 3);
+    EXPECT_FALSE(m.mem->stopped());
+
+    // Stepping on runs the instruction at the breakpoint
+    m.step();
+    EXPECT_EQ(pc->get(), 0xF802);
+
+    // Each call goes further back, and once there is nothing earlier to
+    // stop at, to the start of history
+    while(m.reverseContinue()) {}
+    EXPECT_EQ(m.rewindDepth(), 0u);
+}
+
+// Machines running the stand-in ROM split across threads end where they
+// would on one, each with its own input byte summed up in $01
+TEST(REBatch, MatchesOneThread) {
+    std::vector<uint8_t> image = standInRom();
+    auto make = [&](std::size_t i) {
+        AppleIIe *m = new AppleIIe(image.data(), image.size());
+        m->getMem()->write(0x00, i);
+        return m;
+    };
+    REBatch all(256, make, 4), one(256, make, 1);
+    // The same workers take every run
+    for(int run = 0; run < 3; run++) {
+        REBatch::Stats a = all.run(10000), b = one.run(10000);
+        EXPECT_EQ(a.instructions, 256u * 10000);
+        EXPECT_EQ(a.instructions, b.instructions);
+        EXPECT_EQ(a.cycles, b.cycles);
+    }
+    for(std::size_t i = 0; i < all.size(); i++) {
+        ASSERT_EQ(all[i]->getMem()->read(0x01), one[i]->getMem()->read(0x01)) << "machine " << i;
+        ASSERT_EQ(all[i]->getCycles(), one[i]->getCycles()) << "machine " << i;
+    }
+
+    // Machines stopped at a breakpoint only count what they ran: reset and
+    // the seven instructions before the INX
+    REBatch watched(64, [&](std::size_t i) {
+        AppleIIe *m = new AppleIIe(image.data(), image.size());
+        if(i & 1) m->getMem()->watch(0xF80A, 1, RAM<uint16_t, uint8_t>::WATCH_EXEC);
+        return m;
+    }, 4);
+    EXPECT_EQ(watched.run(1000).instructions, 32u * 1000 + 32u * 8);
+}
+
+// One 7x8 character cell of the image
+static std::vector<uint32_t> cell(const AppleIIeVideo &video, int row, int col) {
+    std::vector<uint32_t> out;
+    for(int y = row * 8; y < row * 8 + 8; y++) {
+        const uint32_t *line = video.pixels() + y * AppleIIeVideo::WIDTH + col * 7;
+        out.insert(out.end(), line, line + 7);
+    }
+    return out;
+}
+
+// "AB!" in normal uppercase on the top row and "ab!" in lowercase on the
+// next, which has to draw the same letters rather than the symbols 32
+// characters below them
+TEST(AppleIIeVideo, LowercaseText) {
+    std::vector<uint8_t> mem(0x10000, 0xA0); // Spaces
+    std::vector<uint32_t> versions(0x100, 0);
+    const uint8_t upper[] = {0xC1, 0xC2, 0xA1};
+    const uint8_t lower[] = {0xE1, 0xE2, 0xA1};
+    memcpy(&mem[0x400], upper, sizeof(upper));
+    memcpy(&mem[0x480], lower, sizeof(lower));
+
+    AppleIIeVideo video;
+    int top, bottom;
+    ASSERT_TRUE(video.update(mem.data(), versions.data(), {true, false, false, false, false}, top, bottom));
+
+    // Top line of A is its apex, one lit pixel in the middle of the cell
+    std::vector<uint32_t> a = cell(video, 0, 0);
+    EXPECT_NE(a[3], a[0]);
+    EXPECT_EQ(a[2], a[0]);
+    EXPECT_EQ(a[4], a[0]);
+
+    for(int col = 0; col < 3; col++) EXPECT_EQ(cell(video, 1, col), cell(video, 0, col)) << "column " << col;
+    EXPECT_NE(cell(video, 1, 0), cell(video, 0, 2)); // 'a' is not '!'
+}
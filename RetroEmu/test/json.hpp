@@ -0,0 +1,144 @@
+#ifndef TEST_JSON_H
+#define TEST_JSON_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Just enough JSON to read test vectors. Escapes keep the escaped
+// character as is and numbers are doubles, which holds every value the
+// vectors use.
+class TestJSON {
+public:
+    enum Type { NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT };
+
+    Type type = NUL;
+    double number = 0;
+    std::string string;
+    std::vector<TestJSON> items;
+    std::vector<std::pair<std::string, TestJSON>> members;
+
+    static bool load(const std::string &path, TestJSON &out) {
+        std::ifstream file(path, std::ios::binary);
+        if(!file.is_open()) return false;
+        std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        const char *p = text.c_str();
+        return parse(p, out) && !*skip(p);
+    }
+
+    const TestJSON &operator[](const char *key) const {
+        static const TestJSON none;
+        for(auto &m : members) {
+            if(m.first == key) return m.second;
+        }
+        return none;
+    }
+
+    // Takes an int so that a literal 0 is not taken for a key
+    const TestJSON &operator[](int i) const {
+        return items[i];
+    }
+
+    std::size_t size() const {
+        return items.size();
+    }
+
+    uint32_t u32() const {
+        return (uint32_t)number;
+    }
+
+private:
+    static const char *skip(const char *&p) {
+        while(*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t') p++;
+        return p;
+    }
+
+    static bool parseString(const char *&p, std::string &out) {
+        p++;
+        while(*p && *p != '"') {
+            if(*p == '\\' && p[1]) p++;
+            out += *p++;
+        }
+        if(*p != '"') return false;
+        p++;
+        return true;
+    }
+
+    static bool parse(const char *&p, TestJSON &out) {
+        switch(*skip(p)) {
+        case '{':
+            out.type = OBJECT;
+            p++;
+            if(*skip(p) == '}') {
+                p++;
+                return true;
+            }
+            while(true) {
+                std::string key;
+                if(*skip(p) != '"' || !parseString(p, key) || *skip(p) != ':') return false;
+                p++;
+                out.members.emplace_back(std::move(key), TestJSON());
+                if(!parse(p, out.members.back().second)) return false;
+                if(*skip(p) == ',') {
+                    p++;
+                } else {
+                    break;
+                }
+            }
+            if(*p != '}') return false;
+            p++;
+            return true;
+        case '[':
+            out.type = ARRAY;
+            p++;
+            if(*skip(p) == ']') {
+                p++;
+                return true;
+            }
+            while(true) {
+                out.items.emplace_back();
+                if(!parse(p, out.items.back())) return false;
+                if(*skip(p) == ',') {
+                    p++;
+                } else {
+                    break;
+                }
+            }
+            if(*p != ']') return false;
+            p++;
+            return true;
+        case '"':
+            out.type = STRING;
+            return parseString(p, out.string);
+        case 't':
+        case 'f':
+        case 'n': {
+            const char *words[] = {"true", "false", "null"};
+            for(const char *w : words) {
+                std::size_t n = std::char_traits<char>::length(w);
+                if(std::string(p, n) != w) continue;
+                out.type = *w == 'n' ? NUL : BOOL;
+                out.number = *w == 't';
+                p += n;
+                return true;
+            }
+            return false;
+        }
+        default: {
+            char *end;
+            out.type = NUMBER;
+            out.number = strtod(p, &end);
+            if(end == p) return false;
+            p = end;
+            return true;
+        }
+        }
+    }
+};
+
+#endif
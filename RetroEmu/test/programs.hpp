@@ -0,0 +1,86 @@
+#ifndef __PROGRAMS_HPP
+#define __PROGRAMS_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <common/ram.hpp>
+
+// Small 6502 programs shared by the tests and the bench, so both measure
+// and check the same code.
+
+// The trace core's workload: a loop with a subroutine call, decimal
+// arithmetic, stores next to the code, and code that rewrites its own
+// immediate operands every time round, so blocks keep being rechecked
+inline const uint8_t WORKLOAD[] = {
+    0xA2, 0x00,       // 0400 LDX #$00       (operand rewritten below)
+    0x8A,             // 0402 TXA
+    0x18,             // 0403 CLC
+    0x65, 0x10,       // 0404 ADC $10
+    0x9D, 0x00, 0x03, // 0406 STA $0300,X
+    0x49, 0x5A,       // 0409 EOR #$5A
+    0x85, 0x10,       // 040B STA $10
+    0x20, 0x40, 0x04, // 040D JSR $0440
+    0xE8,             // 0410 INX
+    0xD0, 0xEF,       // 0411 BNE $0402
+    0xEE, 0x01, 0x04, // 0413 INC $0401
+    0xAD, 0x01, 0x04, // 0416 LDA $0401
+    0x8D, 0x21, 0x04, // 0419 STA $0421
+    0xF8,             // 041C SED
+    0x4C, 0x20, 0x04, // 041D JMP $0420
+    0xA9, 0x00,       // 0420 LDA #$00       (operand rewritten above)
+    0x69, 0x19,       // 0422 ADC #$19
+    0xD8,             // 0424 CLD
+    0x8D, 0x50, 0x04, // 0425 STA $0450      (data on the code page)
+    0x4C, 0x00, 0x04, // 0428 JMP $0400
+};
+
+inline const uint8_t WORKLOAD_SUB[] = {
+    0xA4, 0x10,       // 0440 LDY $10
+    0xC8,             // 0442 INY
+    0x98,             // 0443 TYA
+    0x0A,             // 0444 ASL A
+    0x26, 0x11,       // 0445 ROL $11
+    0xE5, 0x11,       // 0447 SBC $11
+    0x85, 0x12,       // 0449 STA $12
+    0x60,             // 044B RTS
+};
+
+// Maps 64K of RAM and loads the workload with the reset vector at $0400
+inline void loadWorkload(RAM<uint16_t, uint8_t> &mem) {
+    mem.mapMem("ram", 0, 0x10000, true);
+    for(std::size_t i = 0; i < sizeof(WORKLOAD); i++) mem.write(0x0400 + i, WORKLOAD[i]);
+    for(std::size_t i = 0; i < sizeof(WORKLOAD_SUB); i++) mem.write(0x0440 + i, WORKLOAD_SUB[i]);
+    mem.write(0xFFFC, 0x00);
+    mem.write(0xFFFD, 0x04);
+}
+
+// 2K ROM at $F800 holding program, with the reset vector pointing at it
+inline std::vector<uint8_t> monitorRom(const std::vector<uint8_t> &program) {
+    std::vector<uint8_t> image(0x800);
+    memcpy(image.data(), program.data(), program.size());
+    image[0x7FC] = 0x00;
+    image[0x7FD] = 0xF8;
+    return image;
+}
+
+// Stand-in monitor ROM for when no real one is given: a loop storing its
+// input byte ($00) across page 2, with a subroutine call each time round
+// summing it up in $01
+inline std::vector<uint8_t> standInRom() {
+    return monitorRom({
+        0xA2, 0x00,       // F800 LDX #$00
+        0xA5, 0x00,       // F802 LDA $00
+        0x9D, 0x00, 0x02, // F804 STA $0200,X
+        0x20, 0x10, 0xF8, // F807 JSR $F810
+        0xE8,             // F80A INX
+        0x4C, 0x02, 0xF8, // F80B JMP $F802
+        0xEA, 0xEA,
+        0x69, 0x01,       // F810 ADC #$01
+        0x85, 0x01,       // F812 STA $01
+        0x60,             // F814 RTS
+    });
+}
+
+#endif
@@ -0,0 +1,122 @@
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include <common/ram.hpp>
+#include <cpu/6502.hpp>
+#include <test/programs.hpp>
+
+// Runs the trace core in lockstep with the table core, in uneven slices
+// of instructions and of cycles so block boundaries fall everywhere, and
+// compares the whole machine after every slice.
+
+struct Workload {
+    RAM<uint16_t, uint8_t> mem;
+    MOS6502 cpu;
+
+    Workload(MOS6502::Core core) : cpu(&mem, core) {
+        loadWorkload(mem);
+    }
+
+    std::vector<uint8_t> state() {
+        std::vector<uint8_t> out;
+        REStateWriter w(out);
+        cpu.save(w);
+        mem.save(w);
+        return out;
+    }
+};
+
+// Returns how many times the runs stopped at a watch, resuming both each
+// time once they agree on the hit
+static uint64_t lockstep(uint64_t checked, std::function<void(RAM<uint16_t, uint8_t> &)> watch = nullptr) {
+    Workload table(MOS6502::CORE_TABLE), trace(MOS6502::CORE_TRACE);
+    if(watch) {
+        watch(table.mem);
+        watch(trace.mem);
+    }
+
+    uint64_t ran = 0, stops = 0;
+    for(uint32_t i = 0; ran < checked; i++) {
+        uint32_t k = 1 + (i * 7919) % 53;
+        if(i & 1) {
+            table.cpu.runCycles(k);
+            trace.cpu.runCycles(k);
+        } else {
+            table.cpu.run(k);
+            trace.cpu.run(k);
+        }
+        ran += k;
+
+        EXPECT_EQ(trace.mem.stopped(), table.mem.stopped()) << "within " << k << " instructions of " << ran;
+        if(table.state() != trace.state()) {
+            ADD_FAILURE() << "trace core diverged within " << k << " instructions of " << ran;
+            break;
+        }
+        if(table.mem.stopped()) {
+            EXPECT_EQ(trace.mem.lastHit().addr, table.mem.lastHit().addr);
+            EXPECT_EQ(trace.mem.lastHit().kind, table.mem.lastHit().kind);
+            table.mem.resume();
+            trace.mem.resume();
+            stops++;
+        }
+    }
+    return stops;
+}
+
+TEST(TraceCore, Lockstep) {
+    EXPECT_EQ(lockstep(2000000), 0u);
+}
+
+// Watches on data pages leave the code to trace blocks, which have to
+// stop after the op that hit, even in the middle of a block
+TEST(TraceCore, DataWatches) {
+    uint64_t stops = lockstep(1000000, [](RAM<uint16_t, uint8_t> &mem) {
+        mem.watch(0x0321, 1, RAM<uint16_t, uint8_t>::WATCH_WRITE);
+        mem.watch(0x0010, 1, RAM<uint16_t, uint8_t>::WATCH_READ, [](uint16_t, uint8_t data) { return (data & 0x0F) == 0; });
+    });
+    EXPECT_GT(stops, 0u);
+}
+
+// A breakpoint on the code page keeps blocks off it altogether
+TEST(TraceCore, Breakpoint) {
+    uint64_t stops = lockstep(500000, [](RAM<uint16_t, uint8_t> &mem) {
+        mem.watch(0x0413, 1, RAM<uint16_t, uint8_t>::WATCH_EXEC);
+    });
+    EXPECT_GT(stops, 0u);
+}
+
+// A watch's after check sees the registers once the instruction is done:
+// LDY $10 only counts when Y already holds what it read, which it never
+// does mid-instruction. Every core has to agree.
+TEST(Watches, AfterCheck) {
+    for(MOS6502::Core core : {MOS6502::CORE_SWITCH, MOS6502::CORE_TABLE, MOS6502::CORE_TRACE}) {
+        SCOPED_TRACE(core);
+        Workload w(core);
+        Register *pc = (*w.cpu.getRegs())["PC"];
+        Register *x = (*w.cpu.getRegs())["X"];
+        Register *y = (*w.cpu.getRegs())["Y"];
+
+        uint32_t id = w.mem.watch(0x0010, 1, RAM<uint16_t, uint8_t>::WATCH_READ, nullptr,
+            [&] { return pc->get() == 0x0442 && y->get() == w.mem.peek(0x0010); });
+        int stops = 0;
+        for(int i = 0; i < 1000; i++) {
+            w.cpu.run(100);
+            if(!w.mem.stopped()) continue;
+            EXPECT_EQ(pc->get(), 0x0442u);
+            EXPECT_EQ(w.mem.lastHit().id, id);
+            w.mem.resume();
+            stops++;
+        }
+        EXPECT_GT(stops, 0);
+        w.mem.unwatch(id);
+
+        // For a breakpoint it is asked before the instruction runs
+        w.mem.watch(0x0440, 1, RAM<uint16_t, uint8_t>::WATCH_EXEC, nullptr, [&] { return x->get() == 0x80; });
+        w.cpu.run(100000);
+        EXPECT_TRUE(w.mem.stopped());
+        EXPECT_EQ(pc->get(), 0x0440u);
+        EXPECT_EQ(x->get(), 0x80u);
+    }
+}
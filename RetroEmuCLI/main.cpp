@@ -0,0 +1,300 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <format>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <spdlog/spdlog.h>
+
+#include <common/ram.hpp>
+#include <cpu/6502.hpp>
+
+// Headless runner: maps binaries into a flat 64K 6502 address space, runs
+// for a cycle budget or until a trap address, then dumps state to stdout.
+
+// Exit codes, besides 0 for a run that went to the end
+#define EXIT_ERROR 1     // Bad arguments, files that failed to load or save
+#define EXIT_NO_TRAP 2   // -t was given but the address was never reached
+#define EXIT_WATCH 3     // Stopped by -b or -w
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -l FILE@ADDR   copy FILE into RAM at ADDR\n"
+        "  -r FILE@ADDR   map FILE read-only at ADDR\n"
+        "  -p ADDR        start at ADDR instead of the reset vector\n"
+        "  -c CYCLES      cycle budget (default 1000000)\n"
+        "  -t ADDR        stop when PC reaches ADDR\n"
+        "  -j             stop on a jump-to-self loop\n"
+        "  -b ADDR        stop before running ADDR (repeatable)\n"
+        "  -w ADDR:LEN    stop after a write to LEN bytes from ADDR (repeatable)\n"
+        "  -d ADDR:LEN    dump LEN bytes from ADDR when done (repeatable)\n"
+        "  -L FILE        restore a save state after mapping\n"
+        "  -S FILE        write a save state when done\n"
+        "  -s             use the legacy switch core\n"
+        "  -T             use the trace core\n"
+        "  -x FILE        record every instruction to a trace FILE\n"
+        "  -n RECORDS     keep the last RECORDS in the trace (default 1048576)\n"
+        "  -P FILE        write a profile report to FILE, or - for stdout\n"
+        "  -v             verbose logging\n"
+        "Exits 1 on errors, 2 if the -t address was never reached, and 3 if\n"
+        "a -b or -w watch stopped the run.\n",
+        argv0);
+}
+
+// Splits "FILE@ADDR" or "ADDR:LEN" at the last separator
+static bool splitArg(const char *arg, char sep, std::string &left, unsigned long &right) {
+    const char *p = strrchr(arg, sep);
+    if(!p) return false;
+    left = std::string(arg, p - arg);
+    char *end;
+    right = strtoul(p + 1, &end, 16);
+    return *end == '\0' && end != p + 1;
+}
+
+static bool loadFile(RAM<uint16_t, uint8_t> *mem, const std::string &path, uint16_t addr) {
+    std::ifstream file(path, std::ios::binary);
+    if(!file.is_open()) {
+        spdlog::error(std::format("Failed to open \"{}\"", path));
+        return false;
+    }
+
+    std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if(addr + data.size() > 0x10000) {
+        spdlog::error(std::format("\"{}\" does not fit at 0x{:04x}", path, addr));
+        return false;
+    }
+
+    for(std::size_t i = 0; i < data.size(); i++) {
+        mem->write(addr + i, data[i]);
+    }
+    return true;
+}
+
+// Maps path read-only at addr, under id, which mapFil keeps
+static bool mapRom(RAM<uint16_t, uint8_t> *mem, const char *id, const char *path, uint16_t addr) {
+    struct stat st;
+    if(stat(path, &st) != 0) {
+        spdlog::error(std::format("Failed to open \"{}\"", path));
+        return false;
+    }
+    if(addr + (std::size_t)st.st_size > 0x10000) {
+        spdlog::error(std::format("\"{}\" does not fit at 0x{:04x}", path, addr));
+        return false;
+    }
+    return mem->mapFil(id, addr, 0, path);
+}
+
+static bool saveState(MOS6502 *cpu, RAM<uint16_t, uint8_t> *mem, const char *path) {
+    std::vector<uint8_t> state;
+    REStateWriter w(state);
+    w.header("RetroEmuCLI");
+    cpu->save(w);
+    mem->save(w);
+
+    std::ofstream file(path, std::ios::binary);
+    file.write((const char *)state.data(), state.size());
+    if(!file) {
+        spdlog::error(std::format("Failed to write \"{}\"", path));
+        return false;
+    }
+    return true;
+}
+
+static bool loadState(MOS6502 *cpu, RAM<uint16_t, uint8_t> *mem, const char *path) {
+    std::ifstream file(path, std::ios::binary);
+    if(!file.is_open()) {
+        spdlog::error(std::format("Failed to open \"{}\"", path));
+        return false;
+    }
+    std::vector<uint8_t> state((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    for(bool apply : {false, true}) {
+        REStateReader r(state);
+        if(!r.header("RetroEmuCLI")) {
+            spdlog::error(std::format("\"{}\" is not a RetroEmuCLI save state", path));
+            return false;
+        }
+        if(!cpu->load(r, apply) || !mem->load(r, apply)) return false;
+    }
+    return true;
+}
+
+static void dumpRegs(MOS6502 *cpu) {
+    std::map<std::string, Register *> *regs = cpu->getRegs()->getAll();
+    for(auto it = regs->begin(); it != regs->end(); it++) {
+        Register *r = it->second;
+        printf("%s=%0*x ", it->first.c_str(), (r->width + 3) / 4, r->get());
+    }
+    printf("CYCLES=%llu\n", (unsigned long long)cpu->getCycles());
+}
+
+static void dumpMem(RAM<uint16_t, uint8_t> *mem, uint32_t addr, uint32_t len) {
+    for(uint32_t i = 0; i < len; i += 16) {
+        printf("%04x:", addr + i);
+        for(uint32_t j = i; j < len && j < i + 16; j++) {
+            printf(" %02x", mem->peek(addr + j)); // No soft switches or watches
+        }
+        printf("\n");
+    }
+}
+
+int main(int argc, char *argv[]) {
+    spdlog::set_level(spdlog::level::warn);
+
+    RAM<uint16_t, uint8_t> *mem = new RAM<uint16_t, uint8_t>();
+    mem->mapMem("ram", 0, 0x10000, true);
+
+    std::vector<std::pair<uint32_t, uint32_t>> dumps;
+    uint64_t budget = 1000000;
+    long start = -1;
+    long trap = -1;
+    bool selfJump = false;
+    MOS6502::Core core = MOS6502::CORE_TABLE;
+    const char *loadPath = nullptr;
+    const char *savePath = nullptr;
+    const char *tracePath = nullptr;
+    std::size_t traceRecords = 1 << 20;
+    const char *profilePath = nullptr;
+
+    int opt;
+    std::string path;
+    unsigned long val;
+    while((opt = getopt(argc, argv, "l:r:p:c:t:jb:w:d:L:S:sTx:n:P:vh")) != -1) {
+        switch(opt) {
+        case 'l':
+            if(!splitArg(optarg, '@', path, val) || !loadFile(mem, path, val)) return EXIT_ERROR;
+            break;
+        case 'r':
+            // mapFil keeps the id pointer, so hand it argv storage
+            if(!splitArg(optarg, '@', path, val)) return EXIT_ERROR;
+            *strrchr(optarg, '@') = '\0';
+            if(!mapRom(mem, optarg, optarg, val)) return EXIT_ERROR;
+            break;
+        case 'p':
+            start = strtoul(optarg, nullptr, 16);
+            break;
+        case 'c':
+            budget = strtoull(optarg, nullptr, 0);
+            break;
+        case 't':
+            trap = strtoul(optarg, nullptr, 16);
+            break;
+        case 'j':
+            selfJump = true;
+            break;
+        case 'b':
+            mem->watch(strtoul(optarg, nullptr, 16), 1, RAM<uint16_t, uint8_t>::WATCH_EXEC);
+            break;
+        case 'w':
+            if(!splitArg(optarg, ':', path, val)) return EXIT_ERROR;
+            mem->watch(strtoul(path.c_str(), nullptr, 16), val, RAM<uint16_t, uint8_t>::WATCH_WRITE);
+            break;
+        case 'd':
+            if(!splitArg(optarg, ':', path, val)) return EXIT_ERROR;
+            dumps.push_back({(uint32_t)strtoul(path.c_str(), nullptr, 16), (uint32_t)val});
+            break;
+        case 'L':
+            loadPath = optarg;
+            break;
+        case 'S':
+            savePath = optarg;
+            break;
+        case 's':
+            core = MOS6502::CORE_SWITCH;
+            break;
+        case 'T':
+            core = MOS6502::CORE_TRACE;
+            break;
+        case 'x':
+            tracePath = optarg;
+            break;
+        case 'n':
+            traceRecords = strtoull(optarg, nullptr, 0);
+            break;
+        case 'P':
+            profilePath = optarg;
+            break;
+        case 'v':
+            spdlog::set_level(spdlog::level::debug);
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_ERROR;
+        }
+    }
+
+    MOS6502 *cpu = new MOS6502(mem, core);
+    Register *pc = (*cpu->getRegs())["PC"];
+
+    if(loadPath) {
+        if(!loadState(cpu, mem, loadPath)) return EXIT_ERROR;
+    } else {
+        cpu->step(); // Reset sequence
+    }
+    if(start >= 0) *pc = start;
+
+    MOS6502Tracer *tracer = nullptr;
+    if(tracePath) {
+        tracer = new MOS6502Tracer("MOS6502", traceRecords, tracePath);
+        if(!tracer->good()) return EXIT_ERROR;
+        cpu->setTracer(tracer);
+    }
+
+    MOS6502Profile *profile = nullptr;
+    if(profilePath) {
+        profile = new MOS6502Profile();
+        cpu->setProfile(profile);
+    }
+
+    bool trapped = false;
+    uint64_t end = cpu->getCycles() + budget;
+    if(trap < 0 && !selfJump) {
+        cpu->runCycles(budget);
+    } else {
+        while(cpu->getCycles() < end && !mem->stopped()) {
+            uint32_t last = pc->get();
+            cpu->run(1);
+            if(pc->get() == trap || (selfJump && pc->get() == last)) {
+                trapped = true;
+                break;
+            }
+        }
+    }
+
+    if(mem->stopped()) {
+        const RAM<uint16_t, uint8_t>::Hit &hit = mem->lastHit();
+        printf("%s %04x\n", hit.kind == RAM<uint16_t, uint8_t>::WATCH_EXEC ? "BREAK" : "WRITE", hit.addr);
+    }
+
+    if(tracer) {
+        cpu->setTracer(nullptr);
+        delete tracer;
+    }
+
+    if(profile) {
+        cpu->setProfile(nullptr);
+        FILE *out = strcmp(profilePath, "-") ? fopen(profilePath, "w") : stdout;
+        if(!out) {
+            spdlog::error(std::format("Failed to write \"{}\"", profilePath));
+            return EXIT_ERROR;
+        }
+        profile->report(out);
+        if(out != stdout) fclose(out);
+        delete profile;
+    }
+
+    if(savePath && !saveState(cpu, mem, savePath)) return EXIT_ERROR;
+
+    dumpRegs(cpu);
+    for(auto &d : dumps) {
+        dumpMem(mem, d.first, d.second);
+    }
+
+    if(mem->stopped()) return EXIT_WATCH;
+    // A trap that was asked for but never reached is a failure
+    return (trap >= 0 && !trapped) ? EXIT_NO_TRAP : 0;
+}
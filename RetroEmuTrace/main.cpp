@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <spdlog/spdlog.h>
+
+#include <common/tracer.hpp>
+#include <cpu/6502.hpp>
+#include <cpu/6502_disasm.hpp>
+#include <cpu/6502_opcodes.hpp>
+
+// Turns 6502 trace files recorded by RetroEmuCLI -x into text, or finds
+// where two of them part ways.
+
+typedef RETraceReader<MOS6502TraceRecord> Reader;
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+        "Usage: %s [options] FILE\n"
+        "       %s [options] -d FILE FILE\n"
+        "  -d             diff two traces, exiting 1 if they differ\n"
+        "  -f RECORD      start printing at RECORD (default the oldest kept)\n"
+        "  -n COUNT       print at most COUNT records\n"
+        "  -C COUNT       records of context before a difference (default 8)\n"
+        "  -i             ignore cycle counts when diffing\n",
+        argv0, argv0);
+}
+
+static void print(const MOS6502TraceRecord &r, char mark = ' ') {
+    uint16_t pc = r.word & 0xFFFF;
+    char text[MOS6502_DISASM_MAX];
+    int len = disasm6502(r.op, pc, text, sizeof(text));
+
+    char bytes[10] = "";
+    for(int i = 0; i < len; i++) snprintf(bytes + i * 3, 4, "%02X ", r.op[i]);
+
+    printf("%c%12llu  %04X  %-9s %-14s A=%02X X=%02X Y=%02X SP=%02X P=%02X\n", mark, (unsigned long long)(r.word >> 16), pc,
+        bytes, text, r.a, r.x, r.y, r.sp, r.p);
+}
+
+static bool same(const MOS6502TraceRecord &a, const MOS6502TraceRecord &b, bool cycles) {
+    // Only the opcode's own bytes mean anything; the rest is whatever
+    // followed it in memory
+    int len = MOS6502_OPCODES[a.op[0]].length;
+    return (cycles ? a.word == b.word : (a.word & 0xFFFF) == (b.word & 0xFFFF)) && !memcmp(a.op, b.op, len) &&
+           a.a == b.a && a.x == b.x && a.y == b.y && a.sp == b.sp && a.p == b.p;
+}
+
+static int dump(Reader &t, uint64_t from, uint64_t count) {
+    uint64_t end = t.dropped() + t.size();
+    uint64_t first = std::min(std::max(from, t.dropped()), end);
+    if(end - first > count) end = first + count;
+    if(t.dropped()) printf("; %llu older records were overwritten\n", (unsigned long long)t.dropped());
+
+    for(uint64_t i = first; i < end; i++) print(t[i - t.dropped()]);
+    return 0;
+}
+
+// Records are paired by their position in the whole run, so two traces
+// with different capacities still line up over what both kept
+static int diff(Reader &a, Reader &b, uint64_t context, bool cycles) {
+    uint64_t first = std::max(a.dropped(), b.dropped());
+    uint64_t endA = a.dropped() + a.size();
+    uint64_t endB = b.dropped() + b.size();
+    uint64_t end = std::min(endA, endB);
+
+    for(uint64_t i = first; i < end; i++) {
+        const MOS6502TraceRecord &ra = a[i - a.dropped()];
+        const MOS6502TraceRecord &rb = b[i - b.dropped()];
+        if(same(ra, rb, cycles)) continue;
+
+        printf("Traces differ at record %llu\n", (unsigned long long)i);
+        for(uint64_t j = i - std::min(context, i - first); j < i; j++) print(a[j - a.dropped()]);
+        print(ra, '<');
+        print(rb, '>');
+        return 1;
+    }
+
+    if(endA != endB) {
+        printf("Traces match over %llu records, then %s ends\n", (unsigned long long)(end - first),
+            endA < endB ? "the first" : "the second");
+        return 1;
+    }
+    printf("Traces match over %llu records\n", (unsigned long long)(end - first));
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    bool diffing = false;
+    bool cycles = true;
+    uint64_t from = 0;
+    uint64_t count = UINT64_MAX;
+    uint64_t context = 8;
+
+    int opt;
+    while((opt = getopt(argc, argv, "df:n:C:ih")) != -1) {
+        switch(opt) {
+        case 'd':
+            diffing = true;
+            break;
+        case 'f':
+            from = strtoull(optarg, nullptr, 0);
+            break;
+        case 'n':
+            count = strtoull(optarg, nullptr, 0);
+            break;
+        case 'C':
+            context = strtoull(optarg, nullptr, 0);
+            break;
+        case 'i':
+            cycles = false;
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if(argc - optind != (diffing ? 2 : 1)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    Reader a(argv[optind], "MOS6502");
+    if(!a.good()) return 2;
+    if(!diffing) return dump(a, from, count);
+
+    Reader b(argv[optind + 1], "MOS6502");
+    if(!b.good()) return 2;
+    return diff(a, b, context, cycles);
+}
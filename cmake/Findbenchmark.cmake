@@ -0,0 +1,12 @@
+# Add Google Benchmark, preferring an installed copy
+find_package(benchmark CONFIG QUIET)
+if(NOT benchmark_FOUND)
+  include(FetchContent)
+  FetchContent_Declare(
+    googlebenchmark
+    URL https://github.com/google/benchmark/archive/refs/tags/v1.8.3.zip
+  )
+  set(BENCHMARK_ENABLE_TESTING OFF CACHE BOOL "" FORCE)
+  set(BENCHMARK_ENABLE_INSTALL OFF CACHE BOOL "" FORCE)
+  FetchContent_MakeAvailable(googlebenchmark)
+endif()
@@ -1,3 +0,0 @@
-include(FetchContent)
-FetchContent_Declare(goodasm GIT_REPOSITORY https://github.com/travisgoodspeed/goodasm.git)
-FetchContent_MakeAvailable(goodasm)